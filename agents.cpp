@@ -0,0 +1,387 @@
+module;
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+export module agents;
+
+import cards;
+import solver;
+import workers;
+
+export namespace agents {
+using cards::Card;
+using cards::position;
+using solver::Bit;
+using solver::CardSuit;
+using solver::HighestCard;
+
+constexpr int LowestCard(std::uint64_t m) { return std::countr_zero(m); }
+
+constexpr std::uint64_t SuitCards(int s) { return cards::SuitMask(static_cast<cards::suit>(s)); }
+
+constexpr int Rank(int c) { return c % cards::CardsInSuit; }
+
+enum { Jack = 9 };
+
+// What the player to move may go on: the cards of the hand they play from,
+// dummy's once the opening lead is down (and declarer's, playing for dummy),
+// the trick so far and which cards are still out. held has every hand's cards
+// not yet played, so the cards of the trick in progress are no longer in it;
+// an agent must not look at the hidden hands in it one by one.
+struct seatview {
+    const cards::Hand &hand; // of `seat`
+    const cards::trick &t;
+    const solver::handmasks &held;
+    position seat;
+    position declarer;
+    int trumps; // a suit, or solver::NoTrumps
+    bool dummyVisible;
+
+    position Dummy() const { return cards::OffsetPosition(declarer, 2); }
+
+    bool Declaring() const { return !cards::IsOpponent(seat, declarer); }
+
+    std::uint64_t Own() const { return held[static_cast<int>(seat)]; }
+
+    // Our side's other hand, when we can see it
+    std::uint64_t Partner() const {
+        return Declaring() ? held[static_cast<int>(cards::OffsetPosition(seat, 2))] : 0;
+    }
+
+    std::uint64_t Unplayed() const { return held[0] | held[1] | held[2] | held[3]; }
+
+    // Unplayed cards we can't place
+    std::uint64_t Hidden() const {
+        std::uint64_t seen = Own() | Partner();
+        if (dummyVisible)
+            seen |= held[static_cast<int>(Dummy())];
+        return Unplayed() & ~seen;
+    }
+
+    std::uint64_t Legal() const {
+        std::uint64_t m = 0;
+        for (int i = 0; i < cards::CardsInHand; ++i) {
+            if (cards::CardIsValidFromHand(hand, t, i))
+                m |= Bit(hand.crd[i].crd);
+        }
+        return m;
+    }
+
+    int Played() const { return cards::numPlayers - t.PlayersToGo(); }
+
+    int TrickCard(int i) const { return cards::NotPlayed(t.GetCardPlayed(i).crd); }
+
+    // The card winning the trick so far and how far after the leader it was played
+    std::pair<int, int> Winning() const {
+        int win = 0;
+        for (int i = 1; i < Played(); ++i) {
+            if (solver::Beats(TrickCard(i), TrickCard(win), trumps))
+                win = i;
+        }
+        return {TrickCard(win), win};
+    }
+
+    std::uint64_t TrumpCards() const { return solver::TrumpMask(trumps); }
+};
+
+// Chooses the card for the player to move; must return a legal card
+using agent = Card (*)(const seatview &);
+
+inline Card ToCard(int c) { return Card{static_cast<cards::CardInt>(c)}; }
+
+// The lowest of `mine` in c's suit that is as good as c: no unplayed card of
+// anyone else's lies between them
+inline int BottomOfRun(int c, std::uint64_t mine, std::uint64_t unplayed) {
+    int low = c;
+    for (int r = c - 1; r >= CardSuit(c) * cards::CardsInSuit; --r) {
+        if (mine & Bit(r))
+            low = r;
+        else if (unplayed & Bit(r))
+            break;
+    }
+    return low;
+}
+
+// Whether no card we can't see beats c in its suit
+inline bool IsMaster(int c, std::uint64_t hidden) {
+    return !(hidden & SuitCards(CardSuit(c)) & ~(Bit(c + 1) - 1));
+}
+
+// The lowest card of the suit in m with the most losers (cards below its
+// winners), the longest on a tie, sparing trumps while there is anything else
+inline int Discard(const seatview &v, std::uint64_t m) {
+    std::uint64_t pool = (m & ~v.TrumpCards()) ? m & ~v.TrumpCards() : m;
+    std::uint64_t hidden = v.Hidden();
+    int best = -1;
+    int bestLosers = -1;
+    int bestLength = 0;
+    for (int s = 0; s < cards::SuitsInDeck; ++s) {
+        std::uint64_t held = pool & SuitCards(s);
+        int length = std::popcount(held);
+        int losers = length;
+        for (; held && IsMaster(HighestCard(held), hidden); held &= ~Bit(HighestCard(held)))
+            --losers;
+        if (length && (losers > bestLosers || (losers == bestLosers && length > bestLength))) {
+            bestLosers = losers;
+            bestLength = length;
+            best = s;
+        }
+    }
+    return LowestCard(pool & SuitCards(best));
+}
+
+// Following to a trick: second hand low unless an honour is led and can be
+// covered, third hand high (the lowest of equals), fourth hand as cheaply as
+// it can win, and nothing wasted on a trick partner has safely won. Void, ruff
+// as cheaply as possible unless partner is winning, otherwise discard.
+inline int Follow(const seatview &v, std::uint64_t legal) {
+    auto [win, winAt] = v.Winning();
+    int played = v.Played();
+    bool partnerWinning = winAt == played - 2;
+    int led = v.TrickCard(0);
+    std::uint64_t hidden = v.Hidden();
+    std::uint64_t winners = 0;
+    for (std::uint64_t m = legal; m; m &= m - 1) {
+        if (solver::Beats(LowestCard(m), win, v.trumps))
+            winners |= Bit(LowestCard(m));
+    }
+    // Partner's card is safe if no later hand can beat it in its suit
+    bool safe = partnerWinning && (played == 3 || IsMaster(win, hidden));
+
+    if (!(legal & SuitCards(CardSuit(led)))) {
+        if (partnerWinning || !winners)
+            return Discard(v, legal);
+        return LowestCard(winners);
+    }
+    if (!winners || safe)
+        return LowestCard(legal);
+    switch (played) {
+    case 1:
+        if (Rank(led) >= Jack)
+            return LowestCard(winners);
+        return LowestCard(legal);
+    case 2: {
+        int top = HighestCard(winners);
+        int low = BottomOfRun(top, v.Own(), v.Unplayed());
+        // The bottom of the run may be no good against the card already played
+        while (!(winners & Bit(low)))
+            low = LowestCard(v.Own() & SuitCards(CardSuit(top)) & ~(Bit(low + 1) - 1));
+        return low;
+    }
+    default:
+        return LowestCard(winners);
+    }
+}
+
+// Defender's lead: the top of a sequence of honours, a winner, otherwise
+// fourth best (or the lowest) of the longest side suit
+inline int DefenderLead(const seatview &v, std::uint64_t legal) {
+    std::uint64_t side = (legal & ~v.TrumpCards()) ? legal & ~v.TrumpCards() : legal;
+    for (std::uint64_t m = side; m; m &= m - 1) {
+        int c = LowestCard(m);
+        bool top = Rank(c) == cards::CardsInSuit - 1 || !(side & Bit(c + 1));
+        if (Rank(c) >= Jack && top && (side & Bit(c - 1)))
+            return c;
+    }
+    // Winners are cashed, though not on the opening lead at notrumps
+    if (v.trumps != solver::NoTrumps || v.dummyVisible) {
+        std::uint64_t hidden = v.Hidden();
+        for (std::uint64_t m = side; m; m &= m - 1) {
+            if (IsMaster(LowestCard(m), hidden))
+                return LowestCard(m);
+        }
+    }
+    int best = 0;
+    int bestLength = 0;
+    for (int s = 0; s < cards::SuitsInDeck; ++s) {
+        int length = std::popcount(side & SuitCards(s));
+        if (length > bestLength) {
+            bestLength = length;
+            best = s;
+        }
+    }
+    std::uint64_t suit = side & SuitCards(best);
+    for (int i = 0; i < 3 && std::popcount(suit) > 1; ++i)
+        suit &= ~Bit(HighestCard(suit));
+    return HighestCard(suit);
+}
+
+// Declarer's lead from either hand: draw trumps while the defence has some
+// and we hold the top one, cash winners, cross to the other hand's winners,
+// and otherwise lead low from length
+inline int DeclarerLead(const seatview &v, std::uint64_t legal) {
+    std::uint64_t hidden = v.Hidden();
+    std::uint64_t partner = v.Partner();
+    std::uint64_t trumpCards = v.TrumpCards();
+    if (legal & trumpCards && hidden & trumpCards) {
+        int top = HighestCard((legal | partner) & trumpCards);
+        if (IsMaster(top, hidden)) {
+            if (legal & Bit(top))
+                return top;
+            return LowestCard(legal & trumpCards);
+        }
+    }
+    int cash = -1;
+    int cashLength = 0;
+    for (int s = 0; s < cards::SuitsInDeck; ++s) {
+        std::uint64_t ours = legal & SuitCards(s);
+        if (!ours || !IsMaster(HighestCard(ours), hidden))
+            continue;
+        if (std::popcount(ours) > cashLength) {
+            cashLength = std::popcount(ours);
+            cash = HighestCard(ours);
+        }
+    }
+    if (cash >= 0)
+        return cash;
+    for (int s = 0; s < cards::SuitsInDeck; ++s) {
+        std::uint64_t theirs = partner & SuitCards(s);
+        if (theirs && legal & SuitCards(s) && IsMaster(HighestCard(theirs), hidden))
+            return LowestCard(legal & SuitCards(s));
+    }
+    return Discard(v, legal);
+}
+
+inline Card Defender(const seatview &v) {
+    std::uint64_t legal = v.Legal();
+    return ToCard(v.Played() == 0 ? DefenderLead(v, legal) : Follow(v, legal));
+}
+
+inline Card Declarer(const seatview &v) {
+    std::uint64_t legal = v.Legal();
+    return ToCard(v.Played() == 0 ? DeclarerLead(v, legal) : Follow(v, legal));
+}
+
+// The lowest legal card; a floor for the others
+inline Card Lowest(const seatview &v) { return ToCard(LowestCard(v.Legal())); }
+
+// Plays the deal's contract out from the opening lead, declarer's agent
+// playing both declarer's and dummy's cards, and adds the tricks to the deal.
+// Returns the tricks declarer took.
+inline int PlayOut(cards::deal &d, agent declarerAgent, agent defenceAgent) {
+    const cards::contract &c = d.contrct;
+    assert(c.finalContract.IsValid() && c.finalContract.IsABid() && d.GetTricksPlayed() == 0);
+    int trumps = solver::Strain(c.finalContract);
+    solver::handmasks held;
+    for (int p = 0; p < cards::numPlayers; ++p)
+        held[p] = d.hands[p].Mask();
+    d.tricks.reserve(cards::CardsInHand);
+    position leader = cards::Lefty(c.declarer);
+    int taken = 0;
+    for (int n = 0; n < cards::CardsInHand; ++n) {
+        cards::trick t;
+        t.SetLeadPos(leader);
+        t.InitFromContract(c);
+        position seat = leader;
+        for (int k = 0; k < cards::numPlayers; ++k, seat = cards::Lefty(seat)) {
+            seatview v{d.hands[static_cast<int>(seat)], t, held, seat, c.declarer, trumps, n + k > 0};
+            Card cd = cards::IsOpponent(seat, c.declarer) ? defenceAgent(v) : declarerAgent(v);
+            assert(held[static_cast<int>(seat)] & Bit(cd.crd));
+            held[static_cast<int>(seat)] &= ~Bit(cd.crd);
+            t.PlayCard(cd);
+        }
+        d.AddTrick(t);
+        leader = *t.WonBy();
+        taken += !cards::IsOpponent(leader, c.declarer);
+    }
+    return taken;
+}
+
+// Declarer's tricks over a batch of deals played by the agents; on every
+// solveEvery-th deal also the double dummy result, for comparing practical
+// play with perfect play
+struct playsummary {
+    long long deals = 0;
+    long long tricks = 0;
+    long long solved = 0;
+    long long solvedTricks = 0; // by the agents, on the deals solved
+    long long doubleDummyTricks = 0;
+
+    void Merge(const playsummary &o) {
+        deals += o.deals;
+        tricks += o.tricks;
+        solved += o.solved;
+        solvedTricks += o.solvedTricks;
+        doubleDummyTricks += o.doubleDummyTricks;
+    }
+
+    double Practical() const { return deals ? static_cast<double>(tricks) / deals : 0; }
+
+    // Average tricks the agents fall short of double dummy (or gain, if negative)
+    double Shortfall() const {
+        return solved ? static_cast<double>(doubleDummyTricks - solvedTricks) / solved : 0;
+    }
+};
+
+// Plays d into s, after solving it double dummy if given a solver
+inline void Tally(playsummary &s, cards::deal &d, agent declarerAgent, agent defenceAgent,
+                  solver::solver *dds) {
+    int doubleDummy = 0;
+    if (dds) {
+        position declarer = d.contrct.declarer;
+        int trumps = solver::Strain(d.contrct.finalContract);
+        doubleDummy = dds->Tricks(solver::MakePlayState(d, trumps, cards::Lefty(declarer)), declarer);
+    }
+    int taken = PlayOut(d, declarerAgent, defenceAgent);
+    ++s.deals;
+    s.tricks += taken;
+    if (dds) {
+        ++s.solved;
+        s.solvedTricks += taken;
+        s.doubleDummyTricks += doubleDummy;
+    }
+}
+
+// Plays every deal, which must have a finished contract and no tricks yet,
+// across threads. Deals whose index is a multiple of solveEvery are solved.
+inline playsummary PlayDeals(std::vector<cards::deal> &deals, agent declarerAgent, agent defenceAgent,
+                             std::size_t solveEvery = 0, unsigned threads = workers::DefaultThreads()) {
+    threads = std::max(1u, threads);
+    std::vector<playsummary> perThread(threads);
+    std::vector<solver::solver> solvers(solveEvery ? threads : 0);
+    workers::ParallelFor(deals.size(), threads, [&](std::size_t i, unsigned worker) {
+        bool solve = solveEvery && i % solveEvery == 0;
+        Tally(perThread[worker], deals[i], declarerAgent, defenceAgent, solve ? &solvers[worker] : nullptr);
+    });
+    playsummary total;
+    for (const auto &s : perThread)
+        total.Merge(s);
+    return total;
+}
+
+// Deals [0, count) of `seed` played in `contract`, a bid, by `declarer`. Each
+// deal is made by the thread that plays it, so nothing is kept.
+inline playsummary SimulatePlay(std::uint64_t seed, std::uint64_t count, const cards::bid &contract,
+                                position declarer, agent declarerAgent, agent defenceAgent,
+                                std::size_t solveEvery = 0, unsigned threads = workers::DefaultThreads()) {
+    assert(contract.IsABid());
+    cards::contract auction;
+    auction.SetDealer(declarer);
+    auction.AddBid(contract);
+    for (int i = 0; i < 3; ++i)
+        auction.AddBid(cards::bid("P"));
+
+    threads = std::max(1u, threads);
+    std::vector<playsummary> perThread(threads);
+    std::vector<solver::solver> solvers(solveEvery ? threads : 0);
+    workers::ParallelFor(
+        count, threads,
+        [&](std::size_t i, unsigned worker) {
+            cards::deal d(seed, 0, i);
+            d.contrct = auction;
+            bool solve = solveEvery && i % solveEvery == 0;
+            Tally(perThread[worker], d, declarerAgent, defenceAgent, solve ? &solvers[worker] : nullptr);
+        },
+        1024);
+    playsummary total;
+    for (const auto &s : perThread)
+        total.Merge(s);
+    return total;
+}
+} // namespace agents
@@ -0,0 +1,694 @@
+module;
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+export module bench;
+
+import cards;
+import workers;
+
+export namespace bench {
+using cards::position;
+
+enum phase { DealPhase, AuctionPhase, PlayPhase, OutputPhase, Phases };
+
+inline const char *PhaseName(phase p) {
+    constexpr std::array<const char *, Phases> names = {"deal", "auction", "play", "output"};
+    return names[p];
+}
+
+// Time spent in each phase, summed over threads
+struct phasetimes {
+    std::array<std::chrono::nanoseconds, Phases> spent{};
+
+    template <typename F> decltype(auto) Time(phase p, F &&fn) {
+        auto start = std::chrono::steady_clock::now();
+        struct stop {
+            std::chrono::nanoseconds &into;
+            std::chrono::steady_clock::time_point start;
+            ~stop() { into += std::chrono::steady_clock::now() - start; }
+        } s{spent[p], start};
+        return fn();
+    }
+
+    void Merge(const phasetimes &o) {
+        for (int p = 0; p < Phases; ++p)
+            spent[p] += o.spent[p];
+    }
+
+    double Seconds(phase p) const { return std::chrono::duration<double>(spent[p]).count(); }
+};
+
+struct stressreport {
+    std::uint64_t games = 0;
+    std::uint64_t passedOut = 0;
+    std::uint64_t calls = 0;
+    std::uint64_t tricks = 0;
+    std::uint64_t linkBytes = 0;
+    std::uint64_t violations = 0;
+    phasetimes times;
+    double wallSeconds = 0;
+
+    void Merge(const stressreport &o) {
+        games += o.games;
+        passedOut += o.passedOut;
+        calls += o.calls;
+        tricks += o.tricks;
+        linkBytes += o.linkBytes;
+        violations += o.violations;
+        times.Merge(o.times);
+    }
+
+    double GamesPerSecond() const { return wallSeconds > 0 ? games / wallSeconds : 0; }
+
+    std::string to_string() const {
+        std::string out = std::to_string(games) + " games (" + std::to_string(passedOut) +
+                          " passed out), " + std::to_string(static_cast<std::uint64_t>(GamesPerSecond())) +
+                          " games/s, " + std::to_string(violations) + " violations\n";
+        double total = 0;
+        for (int p = 0; p < Phases; ++p)
+            total += times.Seconds(static_cast<phase>(p));
+        for (int p = 0; p < Phases; ++p) {
+            double s = times.Seconds(static_cast<phase>(p));
+            out += std::string(PhaseName(static_cast<phase>(p))) + " " + std::to_string(s) + " s (" +
+                   std::to_string(total > 0 ? static_cast<int>(100 * s / total + 0.5) : 0) + "%)\n";
+        }
+        return out;
+    }
+};
+
+// One random but legal game through the public interface: a random auction
+// through contract::AddBid (each call a pass half the time, otherwise any
+// legal call), then random legal cards trick by trick through trick and
+// deal::AddTrick, then the LIN link. Anything inconsistent along the way
+// counts as a violation.
+inline void PlayRandomGame(std::uint64_t seed, std::uint64_t index, stressreport &report) {
+    cards::counter_rng rng(seed, 1, index);
+    auto d = report.times.Time(DealPhase, [&] {
+        cards::deal dl(seed, 0, index);
+        dl.contrct.SetDealer(static_cast<position>(index % cards::numPlayers));
+        return dl;
+    });
+    ++report.games;
+    auto violation = [&report](bool bad) { report.violations += bad ? 1 : 0; };
+
+    report.times.Time(AuctionPhase, [&] {
+        std::array<cards::bid, cards::bid::NumCalls> legal;
+        while (!d.contrct.finalContract.IsValid()) {
+            int n = 0;
+            for (int i = 1; i < cards::bid::NumCalls; ++i) {
+                cards::bid b = cards::bid::FromCallIndex(i);
+                if (d.contrct.NextBidValid(b))
+                    legal[n++] = b;
+            }
+            cards::bid call = cards::bid::FromCallIndex(0);
+            if (n > 0 && rng.Below(2))
+                call = legal[rng.Below(n)];
+            bool added = d.contrct.AddBid(call);
+            violation(!added);
+            if (!added)
+                break;
+            ++report.calls;
+        }
+        violation(!d.contrct.IsValid());
+    });
+    if (!d.contrct.finalContract.IsValid() || !d.contrct.finalContract.IsABid()) {
+        ++report.passedOut;
+    } else {
+        report.times.Time(PlayPhase, [&] {
+            position leader = cards::Lefty(d.contrct.declarer);
+            std::array<int, 2> won{};
+            for (int t = 0; t < cards::CardsInHand; ++t) {
+                cards::trick tr;
+                tr.SetLeadPos(leader);
+                tr.InitFromContract(d.contrct);
+                position seat = leader;
+                for (int k = 0; k < cards::numPlayers; ++k, seat = cards::Lefty(seat)) {
+                    const cards::Hand &h = d.hands[static_cast<int>(seat)];
+                    std::array<int, cards::CardsInHand> choices;
+                    int n = 0;
+                    for (int i = 0; i < cards::CardsInHand; ++i) {
+                        if (!h.crd[i].CardHasPlayed() && cards::CardIsValidFromHand(h, tr, i))
+                            choices[n++] = i;
+                    }
+                    violation(n == 0);
+                    if (n == 0)
+                        return;
+                    tr.PlayCard(h.crd[choices[rng.Below(n)]]);
+                }
+                auto winner = tr.WonBy();
+                violation(!winner);
+                if (!winner)
+                    return;
+                // the winner played the highest trump, or the highest card of the suit led
+                cards::Card best = tr.GetCardPlayed(0);
+                auto trumps = d.contrct.finalContract.bidSuit();
+                for (int k = 1; k < cards::numPlayers; ++k) {
+                    cards::Card c = tr.GetCardPlayed(k);
+                    bool ruffs = trumps && c.Suit() == *trumps && best.Suit() != *trumps;
+                    if (ruffs || (c.Suit() == best.Suit() && c > best))
+                        best = c;
+                }
+                violation(!(tr.GetCard(*winner) == best));
+                d.AddTrick(tr);
+                ++won[static_cast<int>(*winner) % 2];
+                leader = *winner;
+            }
+            violation(won[0] + won[1] != cards::CardsInHand || d.GetTricksPlayed() != cards::CardsInHand);
+            for (const auto &h : d.hands) {
+                for (int s = 0; s < cards::SuitsInDeck; ++s)
+                    violation(h.SuitLengthRemaining(static_cast<cards::suit>(s)) != 0);
+            }
+            report.tricks += d.GetTricksPlayed();
+        });
+    }
+    report.times.Time(OutputPhase, [&] {
+        std::string link = d.to_link();
+        std::size_t cardsShown = 0;
+        for (auto at = link.find("pc|"); at != std::string::npos; at = link.find("pc|", at + 1))
+            ++cardsShown;
+        violation(cardsShown != static_cast<std::size_t>(d.GetTricksPlayed()) * cards::numPlayers);
+        report.linkBytes += link.size();
+    });
+}
+
+// Games [0, count) played across threads. Everything but the times is the
+// same whatever the number of threads.
+inline stressreport RunGames(std::uint64_t seed, std::uint64_t count,
+                             unsigned threads = workers::DefaultThreads()) {
+    threads = std::max(1u, threads);
+    std::vector<stressreport> perThread(threads);
+    auto start = std::chrono::steady_clock::now();
+    workers::ParallelFor(count, threads,
+                         [&](std::size_t i, unsigned worker) { PlayRandomGame(seed, i, perThread[worker]); });
+    stressreport total;
+    for (const auto &r : perThread)
+        total.Merge(r);
+    total.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return total;
+}
+
+// Allocations made by the calling thread. Only counted when the program
+// replaces operator new to add to it, as the replay tool does, and then sets
+// countingAllocations.
+inline thread_local std::uint64_t allocations = 0;
+inline bool countingAllocations = false;
+
+// A board as recorded: the deal with its dealer and vulnerability, the calls
+// and the cards in the order made, and the LIN it was read from
+struct recordedboard {
+    cards::deal start;
+    std::vector<cards::bid> calls;
+    std::vector<cards::Card> plays;
+    std::string lin;
+};
+
+// A board from a line of LIN. md, sv, mb and pc are read and the rest is
+// skipped; the fourth hand may be left out, and the play must be whole tricks.
+inline std::optional<recordedboard> ParseRecordedBoard(std::string_view lin) {
+    while (!lin.empty() && (lin.back() == '\n' || lin.back() == '\r'))
+        lin.remove_suffix(1);
+    recordedboard b;
+    b.lin = lin;
+    bool dealt = false;
+    std::size_t pos = 0;
+    auto field = [&lin, &pos] {
+        std::size_t end = std::min(lin.find('|', pos), lin.size());
+        std::string_view f = lin.substr(pos, end - pos);
+        pos = std::min(end + 1, lin.size());
+        return f;
+    };
+    while (pos < lin.size()) {
+        std::string_view key = field();
+        std::string_view value = field();
+        if (key == "md") {
+            if (value.empty() || value[0] < '1' || value[0] > '4')
+                return {};
+            b.start.contrct.SetDealer(static_cast<position>(value[0] - '1'));
+            std::array<std::uint64_t, cards::numPlayers> masks{};
+            std::uint64_t seen = 0;
+            std::size_t at = 1;
+            int given = 0;
+            for (; given < cards::numPlayers && at <= value.size(); ++given) {
+                std::size_t end = std::min(value.find(',', at), value.size());
+                if (end == at && given == cards::numPlayers - 1)
+                    break;
+                if (!cards::ParseHandMask(value.substr(at, end - at), masks[given]) || (seen & masks[given]))
+                    return {};
+                seen |= masks[given];
+                at = end + 1;
+            }
+            if (given == cards::numPlayers - 1)
+                masks[given++] = ~seen & ((std::uint64_t{1} << cards::CardsInDeck) - 1);
+            if (given != cards::numPlayers)
+                return {};
+            for (int p = 0; p < cards::numPlayers; ++p)
+                b.start.hands[p] = cards::Hand::FromMask(masks[p]);
+            dealt = true;
+        } else if (key == "sv") {
+            constexpr std::string_view none[] = {"", "o", "0", "-"};
+            if (std::ranges::find(none, value) != std::end(none))
+                b.start.SetVulnerability(cards::vulnerability::neither);
+            else if (value == "n")
+                b.start.SetVulnerability(cards::vulnerability::northsouth);
+            else if (value == "e")
+                b.start.SetVulnerability(cards::vulnerability::eastwest);
+            else if (value == "b")
+                b.start.SetVulnerability(cards::vulnerability::both);
+            else
+                return {};
+        } else if (key == "mb") {
+            if (!value.empty() && value.back() == '!') // alerted
+                value.remove_suffix(1);
+            if (!cards::ParseCall(value, b.calls.emplace_back()))
+                return {};
+        } else if (key == "pc") {
+            if (!cards::ParseCard(value, b.plays.emplace_back()))
+                return {};
+        }
+    }
+    if (!dealt || b.plays.size() % cards::numPlayers != 0 || b.plays.size() > cards::CardsInDeck)
+        return {};
+    return b;
+}
+
+struct replayreport {
+    std::uint64_t boards = 0;
+    std::uint64_t calls = 0;
+    std::uint64_t cards = 0;
+    std::uint64_t linkBytes = 0;
+    std::uint64_t mismatches = 0;
+    std::uint64_t allocations = 0;
+    bool allocationsCounted = false;
+    double wallSeconds = 0;
+
+    void Merge(const replayreport &o) {
+        boards += o.boards;
+        calls += o.calls;
+        cards += o.cards;
+        linkBytes += o.linkBytes;
+        mismatches += o.mismatches;
+        allocations += o.allocations;
+    }
+
+    double BoardsPerSecond() const { return wallSeconds > 0 ? boards / wallSeconds : 0; }
+
+    std::optional<double> AllocationsPerBoard() const {
+        if (!allocationsCounted || boards == 0)
+            return {};
+        return static_cast<double>(allocations) / boards;
+    }
+
+    std::string to_string() const {
+        auto perBoard = AllocationsPerBoard();
+        return std::to_string(boards) + " boards, " +
+               std::to_string(static_cast<std::uint64_t>(BoardsPerSecond())) + " boards/s, " +
+               (perBoard ? std::to_string(*perBoard) : std::string("uncounted")) + " allocations/board, " +
+               std::to_string(mismatches) + " mismatches\n";
+    }
+};
+
+// Replays a board the way a program reading hand records would: the calls
+// through contract::AddBid, the cards through trick::PlayCard and
+// deal::AddTrick, then deal::to_link. A call or card that's refused, or a
+// link that doesn't end with the recorded LIN, is a mismatch; the LIN must
+// have been written by deal::to_lin() for the link to match.
+inline void ReplayBoard(const recordedboard &b, replayreport &report) {
+    std::uint64_t allocated = allocations;
+    cards::deal d = b.start;
+    bool ok = true;
+    for (const auto &call : b.calls) {
+        ok = d.contrct.AddBid(call);
+        if (!ok)
+            break;
+    }
+    if (ok && !b.plays.empty()) {
+        ok = d.contrct.finalContract.IsValid() && d.contrct.finalContract.IsABid();
+        position leader = cards::Lefty(d.contrct.declarer);
+        for (std::size_t at = 0; ok && at < b.plays.size(); at += cards::numPlayers) {
+            cards::trick t;
+            t.SetLeadPos(leader);
+            t.InitFromContract(d.contrct);
+            position seat = leader;
+            for (int k = 0; ok && k < cards::numPlayers; ++k, seat = cards::Lefty(seat)) {
+                const cards::Hand &h = d.hands[static_cast<int>(seat)];
+                cards::Card c = b.plays[at + k];
+                auto held = std::ranges::find_if(
+                    h.crd, [c](const cards::Card &cd) { return cd == c && !cd.CardHasPlayed(); });
+                ok = held != std::end(h.crd) && cards::CardIsValidFromHand(h, t, held - std::begin(h.crd));
+                if (ok)
+                    t.PlayCard(c);
+            }
+            auto winner = ok ? t.WonBy() : std::nullopt;
+            ok = winner.has_value();
+            if (ok) {
+                d.AddTrick(t);
+                leader = *winner;
+            }
+        }
+    }
+    std::string link = d.to_link();
+    report.linkBytes += link.size();
+    report.mismatches += ok && link.ends_with(b.lin) ? 0 : 1;
+    ++report.boards;
+    report.calls += b.calls.size();
+    report.cards += b.plays.size();
+    report.allocations += allocations - allocated;
+}
+
+// The corpus replayed passes times over across threads
+inline replayreport ReplayCorpus(const std::vector<recordedboard> &corpus, std::uint64_t passes,
+                                 unsigned threads = 1) {
+    threads = std::max(1u, threads);
+    std::vector<replayreport> perThread(threads);
+    auto start = std::chrono::steady_clock::now();
+    workers::ParallelFor(corpus.size() * passes, threads, [&](std::size_t i, unsigned worker) {
+        ReplayBoard(corpus[i % corpus.size()], perThread[worker]);
+    });
+    replayreport total;
+    for (const auto &r : perThread)
+        total.Merge(r);
+    total.allocationsCounted = countingAllocations;
+    total.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return total;
+}
+
+// What a replay is held to, kept as a small flat JSON object
+struct replaybaseline {
+    double boardsPerSecond = 0;
+    std::optional<double> allocationsPerBoard;
+    unsigned threads = 1;
+
+    static replaybaseline FromReport(const replayreport &r, unsigned threads) {
+        return {r.BoardsPerSecond(), r.AllocationsPerBoard(), threads};
+    }
+
+    std::string to_json() const {
+        std::string out = "{\n  \"boardsPerSecond\": " + std::to_string(boardsPerSecond) + ",\n";
+        if (allocationsPerBoard)
+            out += "  \"allocationsPerBoard\": " + std::to_string(*allocationsPerBoard) + ",\n";
+        return out + "  \"threads\": " + std::to_string(threads) + "\n}\n";
+    }
+
+    // Reads the object to_json writes; keys it doesn't know are ignored
+    static std::optional<replaybaseline> FromJson(std::string_view json) {
+        auto number = [json](std::string_view key) -> std::optional<double> {
+            std::size_t at = json.find("\"" + std::string(key) + "\"");
+            if (at == std::string_view::npos)
+                return {};
+            at = json.find_first_not_of(" \t\r\n", at + key.size() + 2);
+            if (at == std::string_view::npos || json[at] != ':')
+                return {};
+            at = json.find_first_not_of(" \t\r\n", at + 1);
+            if (at == std::string_view::npos)
+                return {};
+            double v;
+            auto [end, ec] = std::from_chars(json.data() + at, json.data() + json.size(), v);
+            if (ec != std::errc())
+                return {};
+            return v;
+        };
+        auto speed = number("boardsPerSecond");
+        auto threads = number("threads");
+        if (!speed || !threads || *speed <= 0 || *threads < 1)
+            return {};
+        return replaybaseline{*speed, number("allocationsPerBoard"), static_cast<unsigned>(*threads)};
+    }
+};
+
+// Where r falls short of the baseline: fewer boards a second or more
+// allocations a board than tolerance (a fraction) allows, any mismatch, or a
+// different number of threads. Empty if it doesn't.
+inline std::vector<std::string> CompareToBaseline(const replayreport &r, unsigned threads,
+                                                  const replaybaseline &base, double tolerance) {
+    std::vector<std::string> problems;
+    if (r.mismatches > 0)
+        problems.push_back(std::to_string(r.mismatches) + " boards didn't replay as recorded");
+    if (threads != base.threads) {
+        problems.push_back("run with " + std::to_string(threads) + " threads, the baseline with " +
+                           std::to_string(base.threads));
+    }
+    if (r.BoardsPerSecond() < base.boardsPerSecond * (1 - tolerance)) {
+        problems.push_back(std::to_string(r.BoardsPerSecond()) + " boards/s against a baseline of " +
+                           std::to_string(base.boardsPerSecond));
+    }
+    auto perBoard = r.AllocationsPerBoard();
+    if (perBoard && base.allocationsPerBoard && *perBoard > *base.allocationsPerBoard * (1 + tolerance)) {
+        problems.push_back(std::to_string(*perBoard) + " allocations/board against a baseline of " +
+                           std::to_string(*base.allocationsPerBoard));
+    }
+    return problems;
+}
+
+enum counter { Cycles, Instructions, BranchMisses, L1Misses, LlcMisses, Counters };
+
+inline const char *CounterName(counter c) {
+    constexpr std::array<const char *, Counters> names = {"cycles", "instr", "br-miss", "L1-miss",
+                                                          "LLC-miss"};
+    return names[c];
+}
+
+using countervalues = std::array<std::optional<double>, Counters>;
+
+// Hardware counters of the calling thread through perf_event_open. A counter
+// the kernel won't give us (no PMU in a VM, perf_event_paranoid, not Linux)
+// is simply left out and reads as empty. Counts are scaled up when the
+// kernel had to multiplex them.
+class perfcounters {
+  private:
+    std::array<int, Counters> fds;
+
+  public:
+    perfcounters() {
+        fds.fill(-1);
+#ifdef __linux__
+        auto cache = [](std::uint64_t which) {
+            return which | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        };
+        const std::array<std::pair<std::uint32_t, std::uint64_t>, Counters> events = {{
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+            {PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_L1D)},
+            {PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_LL)},
+        }};
+        for (int c = 0; c < Counters; ++c) {
+            perf_event_attr attr{};
+            attr.size = sizeof(attr);
+            attr.type = events[c].first;
+            attr.config = events[c].second;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            fds[c] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+#endif
+    }
+
+    perfcounters(const perfcounters &) = delete;
+    perfcounters &operator=(const perfcounters &) = delete;
+
+    ~perfcounters() {
+#ifdef __linux__
+        for (int fd : fds)
+            if (fd >= 0)
+                close(fd);
+#endif
+    }
+
+    bool Available(counter c) const { return fds[c] >= 0; }
+
+    bool AnyAvailable() const {
+        return std::ranges::any_of(fds, [](int fd) { return fd >= 0; });
+    }
+
+    void Start() {
+#ifdef __linux__
+        for (int fd : fds) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+    }
+
+    countervalues Stop() {
+        countervalues out;
+#ifdef __linux__
+        for (int c = 0; c < Counters; ++c) {
+            if (fds[c] < 0)
+                continue;
+            ioctl(fds[c], PERF_EVENT_IOC_DISABLE, 0);
+            std::uint64_t v[3]; // value, time enabled, time running
+            if (read(fds[c], v, sizeof(v)) == sizeof(v) && v[2] > 0)
+                out[c] = static_cast<double>(v[0]) * v[1] / v[2];
+        }
+#endif
+        return out;
+    }
+};
+
+// Keeps the compiler from dropping a result nobody reads
+template <typename T> void Keep(const T &v) { asm volatile("" : : "r,m"(v) : "memory"); }
+
+struct measurement {
+    std::string name;
+    std::uint64_t ops = 0;
+    double nsPerOp = 0;
+    countervalues perOp; // empty where the counter isn't available
+
+    std::optional<double> Ipc() const {
+        if (perOp[Cycles] && perOp[Instructions] && *perOp[Cycles] > 0)
+            return *perOp[Instructions] / *perOp[Cycles];
+        return {};
+    }
+};
+
+// Times body(ops), which should do ops operations, and counts them with pc if given
+template <typename F>
+measurement Measure(const std::string &name, std::uint64_t ops, F &&body, perfcounters *pc = nullptr) {
+    measurement m{name, ops, 0, {}};
+    if (pc)
+        pc->Start();
+    auto start = std::chrono::steady_clock::now();
+    body(ops);
+    auto spent = std::chrono::steady_clock::now() - start;
+    countervalues totals;
+    if (pc)
+        totals = pc->Stop();
+    m.nsPerOp = std::chrono::duration<double, std::nano>(spent).count() / std::max<std::uint64_t>(ops, 1);
+    for (int c = 0; c < Counters; ++c) {
+        if (totals[c])
+            m.perOp[c] = *totals[c] / std::max<std::uint64_t>(ops, 1);
+    }
+    return m;
+}
+
+// The core primitives one at a time on the calling thread
+inline std::vector<measurement> MeasurePrimitives(std::uint64_t ops, bool useCounters = true) {
+    std::optional<perfcounters> counters;
+    if (useCounters)
+        counters.emplace();
+    perfcounters *pc = counters && counters->AnyAvailable() ? &*counters : nullptr;
+    std::vector<measurement> out;
+
+    out.push_back(Measure(
+        "deal(seed, stream, index)", ops,
+        [](std::uint64_t n) {
+            for (std::uint64_t i = 0; i < n; ++i) {
+                cards::deal d(1, 0, i);
+                Keep(d.hands[0].crd[0].crd);
+            }
+        },
+        pc));
+
+    // hands in dealt order, copied then sorted
+    enum { Pool = 1024 };
+    std::vector<cards::Hand> unsorted(Pool);
+    cards::counter_rng rng(2, 0);
+    for (auto &h : unsorted) {
+        cards::Deck deck = cards::OrderedDeck();
+        cards::ShuffleDeck(deck, rng);
+        for (int i = 0; i < cards::CardsInHand; ++i)
+            h.crd[i].crd = deck[i];
+    }
+    out.push_back(Measure(
+        "Hand::SetSuits", ops,
+        [&](std::uint64_t n) {
+            for (std::uint64_t i = 0; i < n; ++i) {
+                cards::Hand h = unsorted[i % Pool];
+                h.SetSuits();
+                Keep(h.crd[0].crd);
+            }
+        },
+        pc));
+
+    cards::contract auction;
+    auction.SetDealer(position::north);
+    for (auto call : {"1H", "P", "2H", "D"})
+        auction.AddBid(cards::bid(call));
+    out.push_back(Measure(
+        "contract::NextBidValid", ops,
+        [&](std::uint64_t n) {
+            for (std::uint64_t i = 0; i < n; ++i)
+                Keep(auction.NextBidValid(cards::bid::FromCallIndex(i % cards::bid::NumCalls)));
+        },
+        pc));
+
+    cards::deal played(3, 0, 0);
+    cards::trick led;
+    led.SetLeadPos(position::west);
+    led.SetNoTrumps();
+    led.PlayCard(played.hands[static_cast<int>(position::west)].crd[0]);
+    const cards::Hand &north = played.hands[static_cast<int>(position::north)];
+    out.push_back(Measure(
+        "CardIsValidFromHand", ops,
+        [&](std::uint64_t n) {
+            for (std::uint64_t i = 0; i < n; ++i)
+                Keep(cards::CardIsValidFromHand(north, led, i % cards::CardsInHand));
+        },
+        pc));
+
+    out.push_back(Measure(
+        "deal::to_link", ops / 16,
+        [&](std::uint64_t n) {
+            for (std::uint64_t i = 0; i < n; ++i)
+                Keep(played.to_link().size());
+        },
+        pc));
+
+    out.push_back(Measure(
+        "random game", ops / 64,
+        [](std::uint64_t n) {
+            stressreport r;
+            for (std::uint64_t i = 0; i < n; ++i)
+                PlayRandomGame(4, i, r);
+            Keep(r.linkBytes);
+        },
+        pc));
+    return out;
+}
+
+inline std::string FormatMeasurements(const std::vector<measurement> &ms) {
+    auto cell = [](const std::optional<double> &v, int precision) {
+        if (!v)
+            return std::string("-");
+        std::string s = std::to_string(*v);
+        return s.substr(0, s.find('.') + (precision > 0 ? precision + 1 : 0));
+    };
+    auto pad = [](std::string s, std::size_t width) {
+        return s.size() < width ? std::string(width - s.size(), ' ') + s : s;
+    };
+    std::string out = pad("", 28) + pad("ns/op", 10) + pad("IPC", 7);
+    for (int c = 0; c < Counters; ++c)
+        out += pad(CounterName(static_cast<counter>(c)), 10);
+    out += '\n';
+    for (const auto &m : ms) {
+        out += m.name + std::string(m.name.size() < 28 ? 28 - m.name.size() : 1, ' ');
+        out += pad(cell(m.nsPerOp, 1), 10) + pad(cell(m.Ipc(), 2), 7);
+        for (int c = 0; c < Counters; ++c)
+            out += pad(cell(m.perOp[c], 2), 10);
+        out += '\n';
+    }
+    return out;
+}
+} // namespace bench
@@ -0,0 +1,219 @@
+// benchmark: the library measured at volume, one mode at a time
+//
+//   benchmark stress [--games N] [--seed N] [--threads N]
+//   benchmark primitives [--ops N]
+//   benchmark playouts [--deals N] [--seed N] [--threads N]
+//   benchmark leads [--samples N] [--seed N] [--threads N]
+//   benchmark contracts [--samples N] [--seed N] [--threads N]
+//   benchmark tables [--deals N] [--seed N] [--threads N]
+//
+// stress plays random but legal games through the public interface (see
+// bench::PlayRandomGame), a million by default, and reports games a second,
+// the time spent in each phase and any violations, which make the exit
+// status 1.
+//
+// primitives times the core operations one at a time on one thread, 4M
+// operations each by default, with IPC and cache and branch misses an
+// operation from the hardware counters where the kernel gives us them.
+//
+// playouts has the heuristic agents play 3NT by south out on 200000 deals by
+// default, nothing solved, and reports deals a second.
+//
+// leads runs the opening lead simulation against 1NT P 3NT by south, west
+// holding an ordinary 7 count, on 20 samples by default, and reports the time
+// a sample, every lead solved double dummy on a full deal, and what 1000
+// samples would take at that rate.
+//
+// contracts runs the contract choice simulation for south holding
+// KQ985.A73.K65.Q2 after 1S P 2S P, choosing between 2S, 4S and 3NT, on 20
+// samples by default, and reports the time a sample, each candidate solved
+// double dummy on a full deal, and what 1000 samples would take.
+//
+// tables solves full trick tables, every strain and declarer, for 4 deals by
+// default through solver::SolveTables and reports tables an hour.
+//
+// Usage errors exit with status 2.
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+import cards;
+import agents;
+import bench;
+import bidding;
+import solver;
+import workers;
+
+namespace {
+using arguments = std::map<std::string, std::uint64_t>;
+
+std::uint64_t Arg(const arguments &a, const std::string &name, std::uint64_t fallback) {
+    auto it = a.find(name);
+    return it == a.end() ? fallback : it->second;
+}
+
+unsigned Threads(const arguments &a) {
+    return static_cast<unsigned>(Arg(a, "threads", workers::DefaultThreads()));
+}
+
+int Stress(const arguments &a) {
+    auto r = bench::RunGames(Arg(a, "seed", 1), Arg(a, "games", 1000000), Threads(a));
+    std::cout << r.to_string();
+    return r.violations == 0 ? 0 : 1;
+}
+
+int Primitives(const arguments &a) {
+    if (!bench::perfcounters().AnyAvailable())
+        std::cerr << "benchmark: no hardware counters here, timing only\n";
+    std::cout << bench::FormatMeasurements(bench::MeasurePrimitives(Arg(a, "ops", 1 << 22), true));
+    return 0;
+}
+
+int Playouts(const arguments &a) {
+    std::uint64_t deals = Arg(a, "deals", 200000);
+    unsigned threads = Threads(a);
+    auto start = std::chrono::steady_clock::now();
+    auto s = agents::SimulatePlay(Arg(a, "seed", 1), deals, cards::bid("3NT"), cards::position::south,
+                                  agents::Declarer, agents::Defender, 0, threads);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << s.deals << " deals played on " << threads << " threads in " << seconds << " s, "
+              << static_cast<std::uint64_t>(s.deals / seconds) << " deals/s, " << s.Practical()
+              << " tricks to declarer\n";
+    return 0;
+}
+
+int Leads(const arguments &a) {
+    solver::leadproblem prob;
+    prob.contrct.SetDealer(cards::position::south);
+    for (auto call : {"1NT", "P", "3NT", "P", "P", "P"})
+        prob.contrct.AddBid(cards::bid(call));
+    cards::ParseHand("QT82.K73.J95.T62", prob.leaderHand);
+    prob.constraints[static_cast<int>(cards::position::south)].SetPoints(15, 17);
+    int samples = static_cast<int>(Arg(a, "samples", 20));
+    unsigned threads = Threads(a);
+    auto start = std::chrono::steady_clock::now();
+    auto sum = solver::SimulateLeads(prob, samples, Arg(a, "seed", 1), threads);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double perSample = seconds / std::max(sum.samples, 1);
+    std::cout << sum.samples << " samples on " << threads << " threads in " << seconds << " s, "
+              << 1000 * perSample << " ms a sample, 1000 samples in about " << 1000 * perSample << " s\n";
+    if (!sum.leads.empty())
+        std::cout << "best lead " << sum.leads[0].card.to_string() << ", " << sum.leads[0].setPercent
+                  << "% set\n";
+    return 0;
+}
+
+int Contracts(const arguments &a) {
+    std::istringstream rules(": hcp 12-21 spades 5-13 => 1S\n1S P : hcp 6-9 spades 3-13 => 2S\n");
+    bidding::bidder b;
+    b.Load(rules);
+    cards::contract auction;
+    auction.SetDealer(cards::position::south);
+    for (auto call : {"1S", "P", "2S", "P"})
+        auction.AddBid(cards::bid(call));
+    cards::Hand hand;
+    cards::ParseHand("KQ985.A73.K65.Q2", hand);
+    auto prob = solver::MakeContractProblem(b, auction, hand, cards::position::south,
+                                            cards::vulnerability::neither);
+    for (auto call : {"2S", "4S", "3NT"})
+        prob.candidates.push_back({cards::bid(call), cards::position::south});
+    int samples = static_cast<int>(Arg(a, "samples", 20));
+    unsigned threads = Threads(a);
+    auto start = std::chrono::steady_clock::now();
+    auto sum = solver::SimulateContracts(prob, samples, Arg(a, "seed", 3), threads);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double perSample = seconds / std::max(sum.samples, 1);
+    std::cout << sum.samples << " samples on " << threads << " threads in " << seconds << " s, "
+              << 1000 * perSample << " ms a sample, 1000 samples in about " << 1000 * perSample << " s\n";
+    if (!sum.contracts.empty())
+        std::cout << "best contract " << sum.contracts[0].choice.contract.to_link() << ", "
+                  << sum.contracts[0].makePercent << "% made\n";
+    return 0;
+}
+
+int Tables(const arguments &a) {
+    std::vector<cards::deal> deals;
+    std::uint64_t seed = Arg(a, "seed", 1);
+    for (std::uint64_t i = 0; i < Arg(a, "deals", 4); ++i)
+        deals.emplace_back(seed, 0, i);
+    unsigned threads = Threads(a);
+    auto start = std::chrono::steady_clock::now();
+    auto tables = solver::SolveTables(deals, threads);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << tables.size() << " tables on " << threads << " threads in " << seconds << " s, "
+              << seconds / std::max<std::size_t>(tables.size(), 1) << " s a table, "
+              << static_cast<std::uint64_t>(3600 * tables.size() / seconds) << " tables an hour\n";
+    return 0;
+}
+
+struct mode {
+    const char *name;
+    std::vector<std::string> options;
+    int (*run)(const arguments &);
+};
+
+const std::vector<mode> &Modes() {
+    static const std::vector<mode> modes = {
+        {"stress", {"games", "seed", "threads"}, Stress},
+        {"primitives", {"ops"}, Primitives},
+        {"playouts", {"deals", "seed", "threads"}, Playouts},
+        {"leads", {"samples", "seed", "threads"}, Leads},
+        {"contracts", {"samples", "seed", "threads"}, Contracts},
+        {"tables", {"deals", "seed", "threads"}, Tables},
+    };
+    return modes;
+}
+
+void Usage() {
+    std::cerr << "usage: benchmark MODE [--OPTION N]...\n";
+    for (const auto &m : Modes()) {
+        std::cerr << "  " << m.name;
+        for (const auto &o : m.options)
+            std::cerr << " [--" << o << " N]";
+        std::cerr << '\n';
+    }
+}
+
+std::optional<arguments> ParseArguments(const mode &m, int argc, char **argv) {
+    arguments a;
+    for (int i = 2; i < argc; i += 2) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc || !arg.starts_with("--"))
+            return {};
+        std::string name = arg.substr(2);
+        bool known = false;
+        for (const auto &o : m.options)
+            known = known || o == name;
+        const char *value = argv[i + 1];
+        char *end = nullptr;
+        errno = 0;
+        unsigned long long v = std::strtoull(value, &end, 10);
+        if (!known || errno || end == value || *end || *value == '-' || (name == "threads" && v == 0))
+            return {};
+        a[name] = v;
+    }
+    return a;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+    for (const auto &m : Modes()) {
+        if (argc < 2 || argv[1] != std::string(m.name))
+            continue;
+        auto a = ParseArguments(m, argc, argv);
+        if (!a)
+            break;
+        return m.run(*a);
+    }
+    Usage();
+    return 2;
+}
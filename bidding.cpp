@@ -0,0 +1,520 @@
+module;
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <istream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+export module bidding;
+
+import cards;
+
+export namespace bidding {
+using cards::bid;
+using cards::suit;
+
+// Point count and suit lengths packed one per byte (points in byte 0, clubs to
+// spades in bytes 1-4) so that all the ranges of a rule are checked with a
+// couple of subtractions rather than a branch each.
+enum { PointsLane = 0, LengthLane = 1, LaneTop = 127 };
+
+inline constexpr std::uint64_t LaneHighBits = 0x8080808080808080ULL;
+
+constexpr std::uint64_t Lane(int lane, std::uint64_t v) {
+    assert(v <= LaneTop);
+    return v << (8 * lane);
+}
+
+struct handfeatures {
+    std::uint64_t mask;
+    std::uint64_t packed;
+
+    explicit handfeatures(std::uint64_t m) : mask(m) {
+        packed = Lane(PointsLane, cards::MaskPointCount(m));
+        for (int s = 0; s < cards::SuitsInDeck; ++s)
+            packed |= Lane(LengthLane + s, std::popcount(m & cards::SuitMask(static_cast<suit>(s))));
+    }
+
+    explicit handfeatures(const cards::Hand &h) : handfeatures(h.Mask()) {}
+};
+
+struct handconstraint {
+    std::uint64_t low = 0;
+    std::uint64_t high = ~LaneHighBits; // every lane at LaneTop
+    std::uint64_t required = 0;         // cards that must be held
+    std::uint64_t excluded = 0;         // cards that must not be held
+
+    void SetRange(int lane, int lo, int hi) {
+        assert(lo >= 0 && lo <= hi && hi <= LaneTop);
+        low = (low & ~Lane(lane, LaneTop)) | Lane(lane, lo);
+        high = (high & ~Lane(lane, LaneTop)) | Lane(lane, hi);
+    }
+
+    void SetPoints(int lo, int hi) { SetRange(PointsLane, lo, hi); }
+
+    void SetLength(suit s, int lo, int hi) {
+        assert(cards::IsValid(s));
+        SetRange(LengthLane + static_cast<int>(s), lo, hi);
+    }
+
+    int GetLow(int lane) const { return (low >> (8 * lane)) & 0xff; }
+    int GetHigh(int lane) const { return (high >> (8 * lane)) & 0xff; }
+
+    void Require(cards::Card cd) { required |= std::uint64_t{1} << cards::NotPlayed(cd.crd); }
+    void Exclude(cards::Card cd) { excluded |= std::uint64_t{1} << cards::NotPlayed(cd.crd); }
+
+    // Narrows to the hands that meet both. Ranges may cross, and then nothing matches.
+    void Intersect(const handconstraint &o) {
+        for (int lane = PointsLane; lane < LengthLane + static_cast<int>(cards::SuitsInDeck); ++lane) {
+            std::uint64_t m = Lane(lane, LaneTop);
+            low = (low & ~m) | std::max(low & m, o.low & m);
+            high = (high & ~m) | std::min(high & m, o.high & m);
+        }
+        required |= o.required;
+        excluded |= o.excluded;
+    }
+
+    // Widens to the tightest constraint met by every hand that meets either
+    void Widen(const handconstraint &o) {
+        for (int lane = PointsLane; lane < LengthLane + static_cast<int>(cards::SuitsInDeck); ++lane) {
+            std::uint64_t m = Lane(lane, LaneTop);
+            low = (low & ~m) | std::min(low & m, o.low & m);
+            high = (high & ~m) | std::max(high & m, o.high & m);
+        }
+        required &= o.required;
+        excluded &= o.excluded;
+    }
+
+    bool Matches(const handfeatures &f) const {
+        // Bit 7 of a lane survives the subtraction only if the lane is in range
+        std::uint64_t aboveLow = (f.packed | LaneHighBits) - low;
+        std::uint64_t belowHigh = (high | LaneHighBits) - f.packed;
+        return ((aboveLow & belowHigh & LaneHighBits) == LaneHighBits) &
+               ((f.mask & required) == required) & ((f.mask & excluded) == 0);
+    }
+};
+
+// One constraint per seat, south first
+using seatconstraints = std::array<handconstraint, cards::numPlayers>;
+
+struct rule {
+    handconstraint constraint;
+    bid call;
+};
+
+// Auction key: calls from the dealer onwards as call indices
+using auctionkey = std::vector<unsigned char>;
+
+inline auctionkey AuctionKey(const cards::contract &c) {
+    auctionkey key;
+    key.reserve(c.bids.size());
+    std::for_each(std::rbegin(c.bids), std::rend(c.bids),
+                  [&key](const bid &b) { key.push_back(b.CallIndex()); });
+    return key;
+}
+
+inline std::uint64_t HashAuction(std::uint64_t h, int call) {
+    return (h ^ static_cast<std::uint64_t>(call + 1)) * 0x100000001b3ULL;
+}
+
+constexpr std::uint64_t EmptyAuctionHash = 0xcbf29ce484222325ULL;
+
+// Chooses calls from tables of rules keyed by the auction so far. For each
+// auction the first rule whose constraint the hand meets and whose call is
+// legal wins; rules under the "*" auction apply when nothing else matched.
+class bidder {
+  private:
+    struct state {
+        auctionkey key;
+        std::vector<rule> rules;
+    };
+    std::unordered_multimap<std::uint64_t, state> tables;
+    std::vector<rule> fallback;
+
+    static std::uint64_t Hash(const auctionkey &key) {
+        std::uint64_t h = EmptyAuctionHash;
+        for (auto c : key)
+            h = HashAuction(h, c);
+        return h;
+    }
+
+    const std::vector<rule> *Find(const cards::contract &c) const {
+        std::uint64_t h = EmptyAuctionHash;
+        for (auto it = std::rbegin(c.bids); it != std::rend(c.bids); ++it)
+            h = HashAuction(h, it->CallIndex());
+        auto [first, last] = tables.equal_range(h);
+        for (; first != last; ++first) {
+            const auctionkey &k = first->second.key;
+            if (k.size() == c.bids.size() &&
+                std::equal(k.begin(), k.end(), std::rbegin(c.bids),
+                           [](unsigned char a, const bid &b) { return a == b.CallIndex(); }))
+                return &first->second.rules;
+        }
+        return nullptr;
+    }
+
+    std::optional<bid> FirstMatch(const std::vector<rule> &rules, const handfeatures &f,
+                                  const cards::contract &c) const {
+        for (const auto &r : rules) {
+            if (r.constraint.Matches(f) && c.NextBidValid(r.call))
+                return r.call;
+        }
+        return {};
+    }
+
+  public:
+    void AddRule(const auctionkey &key, const rule &r) {
+        std::uint64_t h = Hash(key);
+        auto [first, last] = tables.equal_range(h);
+        for (; first != last; ++first) {
+            if (first->second.key == key) {
+                first->second.rules.push_back(r);
+                return;
+            }
+        }
+        tables.emplace(h, state{key, {r}});
+    }
+
+    void AddFallback(const rule &r) { fallback.push_back(r); }
+
+    std::size_t NumAuctions() const { return tables.size(); }
+
+    // Rules whose auction is exactly this one, or nullptr
+    const std::vector<rule> *RulesFor(const cards::contract &c) const { return Find(c); }
+
+    // The constraint met by every hand the rules would make call b with after
+    // auction c, or nothing if any hand might make it (a call no rule makes,
+    // or a pass, which is also made when no rule applies)
+    std::optional<handconstraint> Shows(const cards::contract &c, const bid &b) const {
+        if (b.IsPass())
+            return {};
+        std::optional<handconstraint> shown;
+        auto widen = [&](const std::vector<rule> &rules) {
+            for (const auto &r : rules) {
+                if (r.call.CallIndex() != b.CallIndex())
+                    continue;
+                if (shown)
+                    shown->Widen(r.constraint);
+                else
+                    shown = r.constraint;
+            }
+        };
+        if (const auto *rules = Find(c))
+            widen(*rules);
+        widen(fallback);
+        return shown;
+    }
+
+    // What the auction shows of each hand, read call by call from the dealer:
+    // each call narrows its bidder's constraint by what it Shows. Rules passed
+    // over are not used, so the constraints are necessary but not sufficient.
+    seatconstraints Infer(const cards::contract &c) const {
+        seatconstraints seats{};
+        cards::contract sofar;
+        sofar.SetDealer(c.GetDealer());
+        for (auto it = std::rbegin(c.bids); it != std::rend(c.bids); ++it) {
+            if (auto shown = Shows(sofar, *it))
+                seats[static_cast<int>(sofar.NextToBid())].Intersect(*shown);
+            sofar.AddBid(*it);
+        }
+        return seats;
+    }
+
+    std::optional<bid> ChooseBid(const cards::Hand &h, const cards::contract &c) const {
+        handfeatures f(h);
+        if (const auto *rules = Find(c)) {
+            if (auto b = FirstMatch(*rules, f, c))
+                return b;
+        }
+        return FirstMatch(fallback, f, c);
+    }
+
+    // Bids the deal to completion from the dealer, passing when no rule applies
+    void BidDeal(cards::deal &d) const {
+        cards::contract &c = d.contrct;
+        while (!c.finalContract.IsValid()) {
+            const cards::Hand &h = d.hands[static_cast<int>(c.NextToBid())];
+            auto b = ChooseBid(h, c);
+            if (!(b && c.AddBid(*b)))
+                c.AddBid(bid("P"));
+        }
+    }
+
+    // Line format, '#' starts a comment:
+    //   <auction> : <constraints> => <call>
+    // where <auction> is the calls so far from the dealer ("1S P", empty for an
+    // opening bid, "*" for any auction) and <constraints> is any of
+    //   hcp 12-21   spades 5-13   hearts 0-3   diamonds 4-4   clubs 2-13
+    //   with AS KS   without QH
+    // Returns the line number of the first bad line; earlier lines are kept.
+    std::optional<int> Load(std::istream &is) {
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(is, line)) {
+            ++lineNumber;
+            line = line.substr(0, line.find('#'));
+            if (line.find_first_not_of(" \t\r") == std::string::npos)
+                continue;
+            if (!ParseRule(line))
+                return lineNumber;
+        }
+        return {};
+    }
+
+    bool ParseRule(const std::string &line) {
+        auto colon = line.find(':');
+        auto arrow = line.find("=>");
+        if (colon == std::string::npos || arrow == std::string::npos || arrow < colon)
+            return false;
+
+        bool any = false;
+        auctionkey key;
+        {
+            std::istringstream auction(line.substr(0, colon));
+            std::string tok;
+            while (auction >> tok) {
+                if (tok == "*") {
+                    any = true;
+                    continue;
+                }
+                auto b = ParseCall(tok);
+                if (!b)
+                    return false;
+                key.push_back(b->CallIndex());
+            }
+            if (any && !key.empty())
+                return false;
+        }
+
+        rule r;
+        {
+            std::istringstream call(line.substr(arrow + 2));
+            std::string tok, extra;
+            if (!(call >> tok) || (call >> extra))
+                return false;
+            auto b = ParseCall(tok);
+            if (!b)
+                return false;
+            r.call = *b;
+        }
+
+        auto constraint = ParseConstraint(line.substr(colon + 1, arrow - colon - 1));
+        if (!constraint)
+            return false;
+        r.constraint = *constraint;
+
+        if (any)
+            AddFallback(r);
+        else
+            AddRule(key, r);
+        return true;
+    }
+
+    // The constraint part of a rule line, such as "hcp 15-17 spades 2-4 with AS"
+    static std::optional<handconstraint> ParseConstraint(const std::string &text) {
+        std::istringstream cons(text);
+        handconstraint c;
+        std::string tok;
+        const std::array<const char *, cards::SuitsInDeck> suitNames = {"clubs", "diamonds",
+                                                                        "hearts", "spades"};
+        enum { none, with, without } cardList = none;
+        while (cons >> tok) {
+            auto s = std::find(suitNames.begin(), suitNames.end(), tok);
+            if (tok == "hcp" || s != suitNames.end()) {
+                cardList = none;
+                std::string range;
+                int lo = 0, hi = 0;
+                char dash = 0;
+                if (!(cons >> range))
+                    return {};
+                std::istringstream rs(range);
+                if (!(rs >> lo >> dash >> hi) || dash != '-' || lo < 0 || lo > hi || hi > LaneTop)
+                    return {};
+                if (s == suitNames.end())
+                    c.SetPoints(lo, hi);
+                else
+                    c.SetLength(static_cast<suit>(s - suitNames.begin()), lo, hi);
+            } else if (tok == "with") {
+                cardList = with;
+            } else if (tok == "without") {
+                cardList = without;
+            } else if (cardList != none) {
+                cards::Card cd;
+                if (tok.size() < 2 || !cd.FromString(tok) || !cd.IsValid())
+                    return {};
+                if (cardList == with)
+                    c.Require(cd);
+                else
+                    c.Exclude(cd);
+            } else {
+                return {};
+            }
+        }
+        return c;
+    }
+
+    static std::optional<bid> ParseCall(const std::string &tok) {
+        if (tok == "P" || tok == "D" || tok == "R")
+            return bid(tok);
+        if (tok.size() >= 2 && tok[0] >= '1' && tok[0] <= '7' &&
+            (tok == std::string{tok[0]} + "NT" ||
+             (tok.size() == 2 && cards::CharToSuit(tok[1])))) {
+            return bid(tok);
+        }
+        return {};
+    }
+};
+using nodeid = std::uint32_t;
+
+// One interned auction prefix and what follows from it
+struct auctionnode {
+    nodeid parent;
+    signed char call;           // call index of the last call, -1 at a root
+    std::uint16_t depth;        // calls so far
+    signed char contractCall;   // highest bid so far, -1 if none
+    unsigned char doubled;      // 0, 1 doubled, 2 redoubled
+    unsigned char passes;       // passes since the last non pass
+    bool finished;
+    cards::position dealer;
+    cards::position contractBidder;
+    cards::position nextToBid;
+    std::uint64_t legal;        // bit i set when call index i may be made next
+
+    bool IsLegal(const bid &b) const { return (legal >> b.CallIndex()) & 1; }
+
+    std::optional<bid> Contract() const {
+        if (contractCall < 0)
+            return {};
+        bid b = bid::FromCallIndex(contractCall);
+        b.SetBidder(contractBidder);
+        return b;
+    }
+};
+
+// Interns auctions as paths in a trie so that every distinct prefix is stored
+// and analysed once. Node ids are dense, so per prefix results of type T are
+// kept in a vector alongside the nodes. The four roots are the empty auctions
+// for each dealer and have the ids of the dealer positions.
+template <typename T = std::monostate> class auctiontrie {
+  private:
+    std::vector<auctionnode> nodes;
+    std::vector<T> data;
+    std::unordered_map<std::uint64_t, nodeid> children;
+
+    static std::uint64_t LegalCalls(const auctionnode &n) {
+        if (n.finished)
+            return 0;
+        std::uint64_t legal = 1; // pass
+        int firstBid = std::max(n.contractCall + 1, static_cast<int>(bid("1C").CallIndex()));
+        legal |= ((std::uint64_t{1} << bid::NumCalls) - 1) & ~((std::uint64_t{1} << firstBid) - 1);
+        if (n.contractCall >= 0) {
+            bool theirs = cards::IsOpponent(n.contractBidder, n.nextToBid);
+            if (theirs && n.doubled == 0)
+                legal |= std::uint64_t{1} << bid("D").CallIndex();
+            if (!theirs && n.doubled == 1)
+                legal |= std::uint64_t{1} << bid("R").CallIndex();
+        }
+        return legal;
+    }
+
+    static auctionnode Next(const auctionnode &n, nodeid parent, const bid &b) {
+        auctionnode c = n;
+        c.parent = parent;
+        c.call = static_cast<signed char>(b.CallIndex());
+        c.depth = n.depth + 1;
+        c.nextToBid = cards::Lefty(n.nextToBid);
+        if (b.IsPass()) {
+            c.passes = n.passes + 1;
+            c.finished = c.passes == (n.contractCall < 0 ? 4 : 3);
+        } else {
+            c.passes = 0;
+            if (b.IsDouble()) {
+                c.doubled = 1;
+            } else if (b.IsReDouble()) {
+                c.doubled = 2;
+            } else {
+                c.contractCall = c.call;
+                c.contractBidder = n.nextToBid;
+                c.doubled = 0;
+            }
+        }
+        c.legal = LegalCalls(c);
+        return c;
+    }
+
+  public:
+    auctiontrie() {
+        for (int p = 0; p < cards::numPlayers; ++p) {
+            auto dealer = static_cast<cards::position>(p);
+            auctionnode root{};
+            root.parent = p;
+            root.call = -1;
+            root.contractCall = -1;
+            root.dealer = root.contractBidder = root.nextToBid = dealer;
+            root.legal = LegalCalls(root);
+            nodes.push_back(root);
+        }
+        data.resize(nodes.size());
+    }
+
+    nodeid Root(cards::position dealer) const { return static_cast<nodeid>(dealer); }
+
+    std::size_t size() const { return nodes.size(); }
+
+    const auctionnode &Node(nodeid id) const { return nodes[id]; }
+
+    T &Data(nodeid id) { return data[id]; }
+    const T &Data(nodeid id) const { return data[id]; }
+
+    // The node for the auction `id` followed by `b`, or nothing if b is not legal there
+    std::optional<nodeid> Child(nodeid id, const bid &b) {
+        const auctionnode &n = nodes[id];
+        if (!n.IsLegal(b))
+            return {};
+        std::uint64_t key = (std::uint64_t{id} << 6) | b.CallIndex();
+        auto [it, added] = children.try_emplace(key, static_cast<nodeid>(nodes.size()));
+        if (added) {
+            nodes.push_back(Next(n, id, b));
+            data.emplace_back();
+        }
+        return it->second;
+    }
+
+    std::optional<nodeid> Find(nodeid id, const bid &b) const {
+        auto it = children.find((std::uint64_t{id} << 6) | b.CallIndex());
+        if (it == children.end())
+            return {};
+        return it->second;
+    }
+
+    std::optional<nodeid> Intern(const cards::contract &c) {
+        nodeid id = Root(c.GetDealer());
+        for (auto it = std::rbegin(c.bids); it != std::rend(c.bids); ++it) {
+            auto next = Child(id, *it);
+            if (!next)
+                return {};
+            id = *next;
+        }
+        return id;
+    }
+
+    // The auction as the contract module stores it, newest call first
+    cards::contract ToContract(nodeid id) const {
+        std::vector<bid> calls;
+        for (; nodes[id].call >= 0; id = nodes[id].parent)
+            calls.push_back(bid::FromCallIndex(nodes[id].call));
+        cards::contract c;
+        c.SetDealer(nodes[id].dealer);
+        std::for_each(std::rbegin(calls), std::rend(calls), [&c](const bid &b) { c.AddBid(b); });
+        return c;
+    }
+};
+} // namespace bidding
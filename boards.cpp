@@ -0,0 +1,202 @@
+module;
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+export module boards;
+
+import cards;
+import workers;
+
+export namespace boards {
+using cards::position;
+using cards::vulnerability;
+
+// Board n (numbered from 1) of the standard 16 board dealer/vulnerability cycle
+inline position BoardDealer(int board) {
+    assert(board > 0);
+    using enum position;
+    constexpr std::array<position, cards::numPlayers> dealers = {north, east, south, west};
+    return dealers[(board - 1) % cards::numPlayers];
+}
+
+inline vulnerability BoardVulnerability(int board) {
+    assert(board > 0);
+    using enum vulnerability;
+    constexpr std::array<vulnerability, 16> vul = {
+        neither, northsouth, eastwest, both,    northsouth, eastwest, both,    neither,
+        eastwest, both,      neither,  northsouth, both,    neither,  northsouth, eastwest};
+    return vul[(board - 1) % 16];
+}
+
+inline char PositionChar(position p) { return "SWNE"[static_cast<int>(p)]; }
+
+inline std::string_view VulnerabilityToPbn(vulnerability v) {
+    switch (v) {
+    case vulnerability::neither:
+        return "None";
+    case vulnerability::eastwest:
+        return "EW";
+    case vulnerability::northsouth:
+        return "NS";
+    case vulnerability::both:
+        return "All";
+    }
+    return "None"; // unreachable
+}
+
+struct boardstats {
+    std::array<int, cards::numPlayers> points;
+    std::array<std::array<char, cards::SuitsInDeck>, cards::numPlayers> lengths;
+    int fitNorthSouth; // longest combined suit
+    int fitEastWest;
+
+    std::string to_string() const {
+        std::string out = "HCP";
+        for (int p = 0; p < cards::numPlayers; ++p) {
+            out += ' ';
+            out += PositionChar(static_cast<position>(p));
+            out += ' ' + std::to_string(points[p]);
+        }
+        out += " fit NS " + std::to_string(fitNorthSouth) + " EW " + std::to_string(fitEastWest);
+        return out;
+    }
+};
+
+inline boardstats MakeStats(const cards::deal &d) {
+    boardstats st{};
+    for (int p = 0; p < cards::numPlayers; ++p) {
+        st.points[p] = d.hands[p].PointCount();
+        for (int s = 0; s < cards::SuitsInDeck; ++s)
+            st.lengths[p][s] = static_cast<char>(d.hands[p].SuitLength(s));
+    }
+    auto fit = [&st](position a, position b) {
+        int best = 0;
+        for (int s = 0; s < cards::SuitsInDeck; ++s)
+            best = std::max(best, st.lengths[static_cast<int>(a)][s] + st.lengths[static_cast<int>(b)][s]);
+        return best;
+    };
+    st.fitNorthSouth = fit(position::north, position::south);
+    st.fitEastWest = fit(position::east, position::west);
+    return st;
+}
+
+struct board {
+    int number;
+    cards::deal d;
+    std::optional<boardstats> stats;
+};
+
+enum class format { lin, pbn, binary };
+
+// Binary record: board number (2 bytes, little endian), dealer, vulnerability,
+// then the owner of each card in deck order packed two bits per card.
+enum { BinaryRecordSize = 4 + cards::CardsInDeck / 4 };
+
+using binaryrecord = std::array<unsigned char, BinaryRecordSize>;
+
+inline binaryrecord ToBinary(const board &b) {
+    binaryrecord rec{};
+    rec[0] = static_cast<unsigned char>(b.number & 0xff);
+    rec[1] = static_cast<unsigned char>((b.number >> 8) & 0xff);
+    rec[2] = static_cast<unsigned char>(b.d.contrct.GetDealer());
+    rec[3] = static_cast<unsigned char>(b.d.GetVulnerability());
+    for (int p = 0; p < cards::numPlayers; ++p) {
+        for (const auto &cd : b.d.hands[p].crd) {
+            int c = cards::NotPlayed(cd.crd);
+            rec[4 + c / 4] |= static_cast<unsigned char>(p << (2 * (c % 4)));
+        }
+    }
+    return rec;
+}
+
+inline board FromBinary(const binaryrecord &rec) {
+    cards::Deck deck;
+    std::array<int, cards::numPlayers> filled{};
+    for (int c = 0; c < cards::CardsInDeck; ++c) {
+        int p = (rec[4 + c / 4] >> (2 * (c % 4))) & 3;
+        assert(filled[p] < cards::CardsInHand);
+        deck[p * cards::CardsInHand + filled[p]++] = static_cast<cards::CardInt>(c);
+    }
+    board b{rec[0] | (rec[1] << 8), cards::deal(deck), {}};
+    b.d.contrct.SetDealer(static_cast<position>(rec[2]));
+    b.d.SetVulnerability(static_cast<vulnerability>(rec[3]));
+    return b;
+}
+
+// Boards of one set. Board n is deal n - 1 of stream `set` under `seed`, so any
+// set (or any single board of it) can be regenerated from the seed alone.
+class boardset {
+  private:
+    std::vector<board> boards;
+
+  public:
+    boardset() = default;
+
+    boardset(std::uint64_t seed, std::uint32_t set, int count, int firstBoard = 1) {
+        assert(count >= 0);
+        assert(firstBoard > 0);
+        boards.reserve(count);
+        for (int n = firstBoard; n < firstBoard + count; ++n) {
+            board &b = boards.emplace_back(board{n, cards::deal(seed, set, n - 1), {}});
+            b.d.contrct.SetDealer(BoardDealer(n));
+            b.d.SetVulnerability(BoardVulnerability(n));
+        }
+    }
+
+    const std::vector<board> &GetBoards() const { return boards; }
+
+    int size() const { return boards.size(); }
+
+    void Annotate(unsigned threads = workers::DefaultThreads()) {
+        workers::ParallelFor(boards.size(), threads,
+                             [this](std::size_t i, unsigned) { boards[i].stats = MakeStats(boards[i].d); });
+    }
+
+    void Write(std::ostream &os, format f) const {
+        for (const auto &b : boards) {
+            switch (f) {
+            case format::lin:
+                os << b.d.to_lin("Board " + std::to_string(b.number)) << '\n';
+                break;
+            case format::pbn:
+                os << "[Board \"" << b.number << "\"]\n";
+                os << "[Dealer \"" << PositionChar(b.d.contrct.GetDealer()) << "\"]\n";
+                os << "[Vulnerable \"" << VulnerabilityToPbn(b.d.GetVulnerability()) << "\"]\n";
+                os << "[Deal \"" << b.d.to_pbn() << "\"]\n";
+                if (b.stats)
+                    os << "{" << b.stats->to_string() << "}\n";
+                os << '\n';
+                break;
+            case format::binary: {
+                auto rec = ToBinary(b);
+                os.write(reinterpret_cast<const char *>(rec.data()), rec.size());
+                break;
+            }
+            }
+        }
+    }
+};
+
+// Sets [firstSet, firstSet + numSets), generated and optionally annotated in parallel
+inline std::vector<boardset> MakeSets(std::uint64_t seed, std::uint32_t firstSet, int numSets,
+                                      int boardsPerSet, bool annotate = false,
+                                      unsigned threads = workers::DefaultThreads()) {
+    std::vector<boardset> sets(numSets);
+    workers::ParallelFor(
+        sets.size(), threads,
+        [&](std::size_t i, unsigned) {
+            sets[i] = boardset(seed, firstSet + i, boardsPerSet);
+            if (annotate)
+                sets[i].Annotate(1);
+        },
+        1);
+    return sets;
+}
+} // namespace boards
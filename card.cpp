@@ -2,13 +2,21 @@ module;
 
 #include <algorithm>
 #include <array>
+#include <bit>
 #include <cassert>
 #include <compare>
+#include <cstdint>
 #include <iostream>
+#include <iterator>
+#include <numeric>
 #include <optional>
 #include <random>
 #include <ranges>
+#include <span>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
 
 export module cards;
 
@@ -78,7 +86,7 @@ inline int GetPositionOffset(position lead, position pos) {
 
 enum class suit : char { clubs = 0, diamonds = 1, hearts = 2, spades = 3, notrumps = 99 };
 const std::string SuitVal = "CDHS";
-const std::string CardVal = "23456789TJQKA";
+inline constexpr std::string_view CardVal = "23456789TJQKA";
 
 inline bool IsValid(const suit s) {
     int i = static_cast<int>(s);
@@ -218,6 +226,40 @@ Card MakeCard(const std::string &st) {
     return cd;
 }
 
+// Bitboards with bit n set for the card whose crd value is n
+constexpr std::uint64_t SuitMask(suit s) {
+    return ((std::uint64_t{1} << CardsInSuit) - 1) << (static_cast<int>(s) * CardsInSuit);
+}
+
+// Every card of rank val (0 is the two, 12 the ace)
+constexpr std::uint64_t RankMask(int val) {
+    std::uint64_t m = 0;
+    for (int s = 0; s < SuitsInDeck; ++s)
+        m |= std::uint64_t{1} << (s * CardsInSuit + val);
+    return m;
+}
+
+constexpr int MaskPointCount(std::uint64_t m) {
+    return 4 * std::popcount(m & RankMask(12)) + 3 * std::popcount(m & RankMask(11)) +
+           2 * std::popcount(m & RankMask(10)) + std::popcount(m & RankMask(9));
+}
+
+// n choose k for n up to a deck; the largest, C(52, 26), fits easily
+constexpr std::uint64_t Binomial(int n, int k) {
+    constexpr auto table = [] {
+        std::array<std::array<std::uint64_t, CardsInDeck + 1>, CardsInDeck + 1> t{};
+        for (int i = 0; i <= CardsInDeck; ++i) {
+            t[i][0] = 1;
+            for (int j = 1; j <= i; ++j)
+                t[i][j] = t[i - 1][j - 1] + (j < i ? t[i - 1][j] : 0);
+        }
+        return t;
+    }();
+    if (n < 0 || k < 0 || k > n || n > CardsInDeck)
+        return 0;
+    return table[n][k];
+}
+
 struct Hand {
     std::array<Card, CardsInHand> crd;
     std::array<char, SuitsInDeck> SuitLengths;
@@ -233,19 +275,13 @@ struct Hand {
     }
 
     bool PlayCard(const Card cd) {
-        auto ub = std::upper_bound(std::begin(crd), std::end(crd), cd);
-
-        if (ub != std::end(crd)) {
-            ub--;
-            if (ub != std::begin(crd)) {
-                int ind = std::distance(std::begin(crd), ub);
-                assert(cd == crd[ind]);
-                crd[ind].SetPlayed();
-                SuitLengths[static_cast<int>(crd[ind].Suit())]--;
-                return true;
-            }
-        }
-        return false;
+        auto lb = std::lower_bound(std::begin(crd), std::end(crd), cd);
+
+        if (lb == std::end(crd) || !(*lb == cd) || lb->CardHasPlayed())
+            return false;
+        lb->SetPlayed();
+        SuitLengths[static_cast<int>(lb->Suit())]--;
+        return true;
     }
 
     int SuitLengthRemaining(const suit s) const {
@@ -292,13 +328,45 @@ struct Hand {
         return lnk;
     }
 
+    std::string to_pbn() const {
+        std::array<std::string, SuitsInDeck> suits;
+        for (const auto &cd : crd) {
+            suits[static_cast<int>(cd.Suit())].insert(0, cd.ShowVal(cards::Card::Use_T_Val));
+        }
+        return suits[static_cast<int>(suit::spades)] + "." + suits[static_cast<int>(suit::hearts)] +
+               "." + suits[static_cast<int>(suit::diamonds)] + "." +
+               suits[static_cast<int>(suit::clubs)];
+    }
+
+    // Cards not yet played
+    std::uint64_t Mask() const {
+        std::uint64_t m = 0;
+        for (const auto &cd : crd) {
+            if (!cd.CardHasPlayed())
+                m |= std::uint64_t{1} << cd.crd;
+        }
+        return m;
+    }
+
+    // The hand holding the 13 cards of a bitboard
+    static Hand FromMask(std::uint64_t m) {
+        assert(std::popcount(m) == CardsInHand);
+        Hand h;
+        for (auto &cd : h.crd) {
+            cd.crd = static_cast<CardInt>(std::countr_zero(m));
+            m &= m - 1;
+        }
+        h.SetSuits();
+        return h;
+    }
+
     int SuitLength(int s) const {
         assert(int(s) >= 0);
         assert(int(s) < SuitsInDeck);
         return SuitLengths[static_cast<int>(s)];
     }
 
-    bool operator==(const Hand &h1) {
+    bool operator==(const Hand &h1) const {
         for (int i = 0; i < SuitsInDeck; ++i) {
             if (SuitLength(i) != h1.SuitLength(i))
                 return false;
@@ -390,6 +458,21 @@ class bid {
 
     std::string DumpRaw() { return std::to_string(s); }
 
+    enum { NumCalls = static_cast<int>(MaxBidSize) * static_cast<int>(ModValue) + offset };
+
+    // Pass, double and redouble are 0-2, then 1C = 3 up to 7NT = NumCalls - 1
+    int CallIndex() const {
+        assert(IsValid());
+        return s;
+    }
+
+    static bid FromCallIndex(int i) {
+        assert(i >= 0 && i < NumCalls);
+        bid b;
+        b.s = static_cast<char>(i);
+        return b;
+    }
+
     void SetBidder(position b) { bidder = b; }
 
     position GetBidder() const { return bidder; }
@@ -413,7 +496,7 @@ class bid {
     void SetReDouble() { s = ReDoubleValue; }
 
     void SetSuit(suit st, int num) {
-        if ((num > 0) && (num < MaxBidSize)) {
+        if ((num > 0) && (num <= MaxBidSize)) {
             int su = static_cast<int>(st);
             assert(su >= 0);
             assert(su < SuitsInDeck);
@@ -428,7 +511,7 @@ class bid {
         if (s >= 0) {
             if (s >= offset) {
                 int cs = ((s - offset) / ModValue) + 1;
-                assert(cs < MaxBidSize);
+                assert(cs <= MaxBidSize);
                 assert(cs > 0);
                 return cs;
             }
@@ -533,8 +616,8 @@ inline std::string vulnerabilitytoLink(vulnerability v) {
 }
 
 struct contract {
-    position declarer;
-    position dealer;
+    position declarer = position::south;
+    position dealer = position::south;
     bid finalContract;
     std::vector<bid> bids;
 
@@ -609,8 +692,9 @@ struct contract {
             }
             assert((begin(bids))->IsPass()); // If righty didn't redouble or bid
                                              // they passed
-            if ((begin(bids) + 1)->IsDouble()) {
-                return false; // Partner already doubled
+            if (std::any_of(begin(bids), pc,
+                            [](const bid &b) { return b.IsDouble() || b.IsReDouble(); })) {
+                return false; // Already doubled, possibly redoubled since
             } else
                 return true;
             assert(false);
@@ -666,7 +750,13 @@ struct contract {
                         finalContract = addBid;
                     } else {
                         finalContract = *pc;
-                        declarer = (*pc).GetBidder();
+                        // Declarer is whoever of the side first named the strain
+                        auto named = std::find_if(bids.crbegin(), std::make_reverse_iterator(pc),
+                                                  [&pc](const bid &b) {
+                                                      return b.IsABid() && b.bidSuit() == pc->bidSuit() &&
+                                                             !IsOpponent(b.GetBidder(), pc->GetBidder());
+                                                  });
+                        declarer = named->GetBidder();
                     }
                 }
             }
@@ -710,6 +800,210 @@ struct contract {
     }
 };
 
+// Parsers over string_views that report what went wrong instead of
+// asserting, and the offset into the input where they found it. Bulk
+// versions fill storage the caller owns, so nothing is allocated per token.
+enum class parseerror : unsigned char {
+    none,
+    empty,
+    badSuit,
+    badRank,
+    badCall,
+    duplicate, // a card given twice
+    tooFew,
+    tooMany,
+    illegalCall // a call that isn't legal at that point of the auction
+};
+
+struct parseresult {
+    parseerror error = parseerror::none;
+    std::size_t offset = 0;
+
+    explicit operator bool() const { return error == parseerror::none; }
+};
+
+namespace parsetables {
+constexpr std::array<signed char, 256> Make(std::string_view upper) {
+    std::array<signed char, 256> t{};
+    t.fill(-1);
+    for (std::size_t i = 0; i < upper.size(); ++i) {
+        t[static_cast<unsigned char>(upper[i])] = static_cast<signed char>(i);
+        if (upper[i] >= 'A' && upper[i] <= 'Z')
+            t[static_cast<unsigned char>(upper[i] - 'A' + 'a')] = static_cast<signed char>(i);
+    }
+    return t;
+}
+
+inline constexpr auto Suits = Make("CDHS");
+inline constexpr auto Ranks = Make("23456789TJQKA");
+
+constexpr bool IsSeparator(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == ',' || c == '|' || c == '-';
+}
+} // namespace parsetables
+
+inline int SuitIndex(char c) { return parsetables::Suits[static_cast<unsigned char>(c)]; }
+
+inline int RankIndex(char c) { return parsetables::Ranks[static_cast<unsigned char>(c)]; }
+
+// The next token of s from pos on, skipping separators; empty at the end
+inline std::string_view NextToken(std::string_view s, std::size_t &pos) {
+    while (pos < s.size() && parsetables::IsSeparator(s[pos]))
+        ++pos;
+    std::size_t start = pos;
+    while (pos < s.size() && !parsetables::IsSeparator(s[pos]))
+        ++pos;
+    return s.substr(start, pos - start);
+}
+
+// "AS", "10S" or, as in LIN, "SA"
+inline parseresult ParseCard(std::string_view s, Card &out) {
+    if (s.empty())
+        return {parseerror::empty, 0};
+    int suitAt = SuitIndex(s[0]) >= 0 ? 0 : static_cast<int>(s.size()) - 1;
+    int st = SuitIndex(s[suitAt]);
+    if (st < 0)
+        return {parseerror::badSuit, static_cast<std::size_t>(suitAt)};
+    std::string_view rank = suitAt == 0 ? s.substr(1) : s.substr(0, s.size() - 1);
+    std::size_t rankAt = suitAt == 0 ? 1 : 0;
+    int r = rank == "10" ? 8 : (rank.size() == 1 ? RankIndex(rank[0]) : -1);
+    if (r < 0)
+        return {parseerror::badRank, rankAt};
+    out.crd = static_cast<CardInt>(st * CardsInSuit + r);
+    return {};
+}
+
+// "P", "Pass", "X", "D", "XX", "R", "1N", "1NT" or a level and a suit
+inline parseresult ParseCall(std::string_view s, bid &out) {
+    if (s.empty())
+        return {parseerror::empty, 0};
+    auto is = [s](std::string_view a, std::string_view b = {}) {
+        auto same = [s](std::string_view w) {
+            return s.size() == w.size() &&
+                   std::ranges::equal(s, w, [](char x, char y) { return (x & ~0x20) == y; });
+        };
+        return same(a) || (!b.empty() && same(b));
+    };
+    if (is("P", "PASS")) {
+        out.SetPass();
+    } else if (is("X", "D")) {
+        out.SetDouble();
+    } else if (is("XX", "R")) {
+        out.SetReDouble();
+    } else {
+        int level = s[0] - '0';
+        if (level < 1 || level > MaxBidSize)
+            return {parseerror::badCall, 0};
+        std::string_view strain = s.substr(1);
+        if (strain.size() == 1 && SuitIndex(strain[0]) >= 0)
+            out.SetSuit(static_cast<suit>(SuitIndex(strain[0])), level);
+        else if (strain.size() >= 1 && strain.size() <= 2 && (strain[0] & ~0x20) == 'N' &&
+                 (strain.size() == 1 || (strain[1] & ~0x20) == 'T'))
+            out.SetNoTrumps(level);
+        else
+            return {parseerror::badCall, 1};
+    }
+    return {};
+}
+
+// A hand as in LIN, "SAKQ2HJT9D...C...", or PBN, "AKQ2.JT9...", as a bitboard
+inline parseresult ParseHandMask(std::string_view s, std::uint64_t &out) {
+    out = 0;
+    bool pbn = s.find('.') != std::string_view::npos;
+    int st = pbn ? static_cast<int>(suit::spades) : -1;
+    for (std::size_t i = 0; i < s.size(); ++i) {
+        char c = s[i];
+        if (pbn && c == '.') {
+            if (--st < 0)
+                return {parseerror::badSuit, i};
+            continue;
+        }
+        if (!pbn && SuitIndex(c) >= 0) {
+            st = SuitIndex(c);
+            continue;
+        }
+        int r = RankIndex(c);
+        if (c == '1' && i + 1 < s.size() && s[i + 1] == '0')
+            r = 8, ++i;
+        if (r < 0)
+            return {parseerror::badRank, i};
+        if (st < 0)
+            return {parseerror::badSuit, i};
+        std::uint64_t bit = std::uint64_t{1} << (st * CardsInSuit + r);
+        if (out & bit)
+            return {parseerror::duplicate, i};
+        if (std::popcount(out) == CardsInHand)
+            return {parseerror::tooMany, i};
+        out |= bit;
+    }
+    if (std::popcount(out) < CardsInHand)
+        return {parseerror::tooFew, s.size()};
+    return {};
+}
+
+inline parseresult ParseHand(std::string_view s, Hand &out) {
+    std::uint64_t m;
+    parseresult r = ParseHandMask(s, m);
+    if (r)
+        out = Hand::FromMask(m);
+    return r;
+}
+
+// Calls separated by spaces, commas, dashes or bars into out; count is how many
+inline parseresult ParseCalls(std::string_view s, std::span<bid> out, std::size_t &count) {
+    count = 0;
+    for (std::size_t pos = 0;;) {
+        std::string_view token = NextToken(s, pos);
+        if (token.empty())
+            return {};
+        std::size_t at = pos - token.size();
+        if (count == out.size())
+            return {parseerror::tooMany, at};
+        parseresult r = ParseCall(token, out[count]);
+        if (!r)
+            return {r.error, at + r.offset};
+        ++count;
+    }
+}
+
+// A whole auction, "1S P 2H P 4S P P P", added to c, whose dealer must be set
+inline parseresult ParseAuction(std::string_view s, contract &c) {
+    for (std::size_t pos = 0;;) {
+        std::string_view token = NextToken(s, pos);
+        if (token.empty())
+            return {};
+        std::size_t at = pos - token.size();
+        bid b;
+        parseresult r = ParseCall(token, b);
+        if (!r)
+            return {r.error, at + r.offset};
+        if (!c.AddBid(b))
+            return {parseerror::illegalCall, at};
+    }
+}
+
+// Cards separated by spaces, commas, dashes or bars into out; count is how many
+inline parseresult ParsePlay(std::string_view s, std::span<Card> out, std::size_t &count) {
+    count = 0;
+    std::uint64_t seen = 0;
+    for (std::size_t pos = 0;;) {
+        std::string_view token = NextToken(s, pos);
+        if (token.empty())
+            return {};
+        std::size_t at = pos - token.size();
+        if (count == out.size())
+            return {parseerror::tooMany, at};
+        parseresult r = ParseCard(token, out[count]);
+        if (!r)
+            return {r.error, at + r.offset};
+        std::uint64_t bit = std::uint64_t{1} << out[count].crd;
+        if (seen & bit)
+            return {parseerror::duplicate, at};
+        seen |= bit;
+        ++count;
+    }
+}
+
 class trick {
   private:
     std::array<Card, numPlayers> crd;
@@ -725,9 +1019,9 @@ class trick {
         return {};
     }
 
-    Card GetCard(const cards::position p) const {
-        return crd[GetPositionOffset(leadPlayer, wonByPlayer)];
-    }
+    Card GetCard(const cards::position p) const { return crd[GetPositionOffset(leadPlayer, p)]; }
+
+    position GetLeadPos() const { return leadPlayer; }
 
     Card GetCardPlayed(int i) const {
         assert(i >= 0);
@@ -842,8 +1136,8 @@ class trick {
             if (CardWillWin(pc))
                 wonByPlayer = OffsetPosition(leadPlayer, cardsPlayed);
             crd[cardsPlayed++] = pc;
-        }
-        assert(false); // unreachable
+        } else
+            assert(false); // trick already complete
     }
 };
 
@@ -873,19 +1167,156 @@ bool CardIsValidFromHand(const Hand &h, const trick &t, int index) {
     return false;
 }
 
+// Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3").
+// The output is a pure function of the counter and key, so any point in a
+// stream can be reached without generating what came before it.
+struct philox4x32 {
+    using counter_type = std::array<std::uint32_t, 4>;
+    using key_type = std::array<std::uint32_t, 2>;
+
+    static constexpr counter_type Generate(counter_type ctr, key_type key) {
+        for (int round = 0; round < 10; ++round) {
+            if (round > 0) {
+                key[0] += 0x9E3779B9;
+                key[1] += 0xBB67AE85;
+            }
+            std::uint64_t p0 = std::uint64_t{0xD2511F53} * ctr[0];
+            std::uint64_t p1 = std::uint64_t{0xCD9E8D57} * ctr[2];
+            ctr = {static_cast<std::uint32_t>(p1 >> 32) ^ ctr[1] ^ key[0],
+                   static_cast<std::uint32_t>(p1),
+                   static_cast<std::uint32_t>(p0 >> 32) ^ ctr[3] ^ key[1],
+                   static_cast<std::uint32_t>(p0)};
+        }
+        return ctr;
+    }
+};
+
+// Random words for deal number `index` of stream `stream` under `seed`.
+// Word j of a deal comes from counter {j / 4, index, stream}, so Seek() is O(1)
+// and the sequence does not depend on the host, the thread count or the order
+// in which deals are generated.
+class counter_rng {
+  private:
+    philox4x32::key_type key;
+    std::uint32_t stream;
+    std::uint64_t index;
+    std::uint32_t block;
+    philox4x32::counter_type buffer;
+    int used;
+
+  public:
+    using result_type = std::uint32_t;
+
+    counter_rng(std::uint64_t seed, std::uint32_t strm, std::uint64_t idx = 0)
+        : key{static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32)},
+          stream(strm) {
+        Seek(idx);
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return UINT32_MAX; }
+
+    void Seek(std::uint64_t idx) {
+        index = idx;
+        block = 0;
+        used = 4;
+    }
+
+    std::uint64_t GetIndex() const { return index; }
+    std::uint32_t GetStream() const { return stream; }
+
+    result_type operator()() {
+        if (used == 4) {
+            buffer = philox4x32::Generate({block++, static_cast<std::uint32_t>(index),
+                                           static_cast<std::uint32_t>(index >> 32), stream},
+                                          key);
+            used = 0;
+        }
+        return buffer[used++];
+    }
+
+    // Unbiased value in [0, n) (Lemire's multiply-shift with rejection).
+    std::uint32_t Below(std::uint32_t n) {
+        assert(n > 0);
+        std::uint64_t m = std::uint64_t{(*this)()} * n;
+        auto low = static_cast<std::uint32_t>(m);
+        if (low < n) {
+            std::uint32_t threshold = (0u - n) % n;
+            while (low < threshold) {
+                m = std::uint64_t{(*this)()} * n;
+                low = static_cast<std::uint32_t>(m);
+            }
+        }
+        return static_cast<std::uint32_t>(m >> 32);
+    }
+};
+
+using Deck = std::array<CardInt, CardsInDeck>;
+
+inline Deck OrderedDeck() {
+    Deck d;
+    std::iota(d.begin(), d.end(), 0);
+    return d;
+}
+
+// Fisher-Yates written out rather than std::shuffle, whose use of the
+// generator is implementation defined.
+inline void ShuffleDeck(Deck &d, counter_rng &rng) {
+    for (int i = CardsInDeck - 1; i > 0; --i) {
+        std::swap(d[i], d[rng.Below(i + 1)]);
+    }
+}
+
+// Indices [first, first + count) of shard `shard` when `total` deals are split
+// into `shards` nearly equal parts.
+struct dealrange {
+    std::uint64_t first;
+    std::uint64_t count;
+};
+
+inline dealrange ShardRange(std::uint64_t total, std::uint64_t shards, std::uint64_t shard) {
+    assert(shards > 0);
+    assert(shard < shards);
+    std::uint64_t base = total / shards;
+    std::uint64_t extra = total % shards;
+    std::uint64_t first = shard * base + std::min(shard, extra);
+    return {first, base + (shard < extra ? 1 : 0)};
+}
+
 struct deal {
     std::array<Hand, cards::numPlayers> hands;
     std::vector<trick> tricks;
     contract contrct;
-    vulnerability v;
+    vulnerability v = vulnerability::neither;
 
     deal() {
-        std::array<CardInt, CardsInDeck> a1;
-        std::iota(a1.begin(), a1.end(), 0);
+        Deck a1 = OrderedDeck();
         std::random_device rd;
         std::mt19937 gen{rd()};
         std::ranges::shuffle(a1, gen);
+        SetHands(a1);
+    }
+
+    // The hands as the deck lies: the first 13 cards to south, then west, north and east
+    explicit deal(const Deck &a1) { SetHands(a1); }
+
+    // Deal number `index` of `stream`; the same arguments always give the same deal.
+    deal(std::uint64_t seed, std::uint32_t stream, std::uint64_t index)
+        : deal(ShuffledDeck(counter_rng(seed, stream, index))) {}
+
+    static Deck ShuffledDeck(counter_rng rng) {
+        Deck a1 = OrderedDeck();
+        ShuffleDeck(a1, rng);
+        return a1;
+    }
 
+    void Deal(counter_rng &rng) {
+        Deck a1 = OrderedDeck();
+        ShuffleDeck(a1, rng);
+        SetHands(a1);
+    }
+
+    void SetHands(const Deck &a1) {
         int i = 0;
         for (auto &h : hands) {
             for (auto &cd : h.crd) {
@@ -914,10 +1345,10 @@ struct deal {
             }
         }
         tricks.emplace_back(t);
-        assert(tricks.size() < CardsInHand);
+        assert(tricks.size() <= CardsInHand);
     }
 
-    bool operator==(const cards::deal &d1) {
+    bool operator==(const cards::deal &d1) const {
         for (int i = 0; i < cards::numPlayers; ++i) {
             if (hands[i] != d1.hands[i]) {
                 return false;
@@ -940,9 +1371,13 @@ struct deal {
         return out;
     }
     std::string to_link() const {
-        std::string lnk = "https://www.bridgebase.com/tools/"
-                          "handviewer.html?lin=";
-        lnk += "st||";
+        return "https://www.bridgebase.com/tools/"
+               "handviewer.html?lin=" +
+               to_lin();
+    }
+
+    std::string to_lin(const std::string &description = "deal") const {
+        std::string lnk = "st||";
         lnk += "pn|~Msouth,~Mwest,~Mnorth,~Meast|";
         lnk += "md|";
         lnk += positiontolinkdealer(contrct.GetDealer());
@@ -961,7 +1396,7 @@ struct deal {
         lnk += "sv|" + vulnerabilitytoLink(v) + "|";
 
         lnk += "rh||";     // not sure what this is yet...
-        lnk += "ah|deal|"; // hand description
+        lnk += "ah|" + description + "|"; // hand description
 
         int i = contrct.bids.size();
 
@@ -976,5 +1411,260 @@ struct deal {
 
         return lnk;
     }
+
+    // PBN deal tag value, hands clockwise from South
+    std::string to_pbn() const {
+        std::string out = "S:";
+        int i = 0;
+        for (const auto &h : hands) {
+            out += h.to_pbn();
+            if (++i < numPlayers)
+                out += " ";
+        }
+        return out;
+    }
+};
+// A deal with its auction and play in a fixed 103 bytes and no pointers, so
+// it can be copied with memcpy and passed through shared memory. Cards take
+// 6 bits (their deck index), and so do calls (their CallIndex); a trick is
+// its four cards in the order played, 3 bytes, its leader following from
+// the contract and the trick before. Auctions longer than MaxCalls don't fit.
+class compactdeal {
+  public:
+    enum { MaxCalls = 64 };
+
+  private:
+    std::array<unsigned char, CardsInDeck / 4> owners; // 2 bits a card, in deck order
+    std::array<unsigned char, CardsInHand * numPlayers * 6 / 8> play;
+    std::array<unsigned char, MaxCalls * 6 / 8> calls;
+    unsigned char numCalls;
+    unsigned char numTricks;
+    unsigned char dealerAndVul; // dealer in the low 2 bits
+
+    template <std::size_t N> static int Get6(const std::array<unsigned char, N> &a, int i) {
+        int bit = 6 * i;
+        int word = a[bit / 8] | (bit / 8 + 1 < static_cast<int>(N) ? a[bit / 8 + 1] << 8 : 0);
+        return (word >> (bit % 8)) & 0x3f;
+    }
+
+    template <std::size_t N> static void Set6(std::array<unsigned char, N> &a, int i, int v) {
+        int bit = 6 * i;
+        a[bit / 8] = static_cast<unsigned char>((a[bit / 8] & ~(0x3f << (bit % 8))) | (v << (bit % 8)));
+        if (bit % 8 > 2)
+            a[bit / 8 + 1] = static_cast<unsigned char>((a[bit / 8 + 1] & ~(0x3f >> (8 - bit % 8))) |
+                                                         (v >> (8 - bit % 8)));
+    }
+
+  public:
+    static std::optional<compactdeal> FromDeal(const deal &d) {
+        compactdeal c{};
+        for (int p = 0; p < numPlayers; ++p) {
+            for (const auto &cd : d.hands[p].crd) {
+                int card = NotPlayed(cd.crd);
+                c.owners[card / 4] |= static_cast<unsigned char>(p << (2 * (card % 4)));
+            }
+        }
+        c.dealerAndVul = static_cast<unsigned char>(static_cast<int>(d.contrct.GetDealer()) |
+                                                    static_cast<int>(d.GetVulnerability()) << 2);
+        if (d.contrct.bids.size() > MaxCalls)
+            return {};
+        for (auto it = d.contrct.bids.rbegin(); it != d.contrct.bids.rend(); ++it)
+            Set6(c.calls, c.numCalls++, it->CallIndex());
+        if (!d.tricks.empty()) {
+            if (!d.contrct.finalContract.IsValid() || !d.contrct.finalContract.IsABid())
+                return {};
+            position leader = Lefty(d.contrct.declarer);
+            for (const auto &t : d.tricks) {
+                if (t.GetLeadPos() != leader || !t.WonBy())
+                    return {};
+                for (int k = 0; k < numPlayers; ++k)
+                    Set6(c.play, c.numTricks * numPlayers + k, NotPlayed(t.GetCardPlayed(k).crd));
+                ++c.numTricks;
+                leader = *t.WonBy();
+            }
+        }
+        return c;
+    }
+
+    // A deal with no auction or play yet, from the cards each hand holds
+    static compactdeal FromHands(const std::array<std::uint64_t, numPlayers> &hands, position dealer,
+                                 vulnerability v) {
+        compactdeal c{};
+        for (int p = 0; p < numPlayers; ++p) {
+            for (std::uint64_t m = hands[p]; m; m &= m - 1) {
+                int card = std::countr_zero(m);
+                c.owners[card / 4] |= static_cast<unsigned char>(p << (2 * (card % 4)));
+            }
+        }
+        c.dealerAndVul = static_cast<unsigned char>(static_cast<int>(dealer) | static_cast<int>(v) << 2);
+        return c;
+    }
+
+    // Replays the auction and the play
+    deal ToDeal() const {
+        Deck deck;
+        std::array<int, numPlayers> filled{};
+        for (int card = 0; card < CardsInDeck; ++card) {
+            int p = Owner(card);
+            assert(filled[p] < CardsInHand);
+            deck[p * CardsInHand + filled[p]++] = static_cast<CardInt>(card);
+        }
+        deal d(deck);
+        d.contrct.SetDealer(GetDealer());
+        d.SetVulnerability(GetVulnerability());
+        for (int i = 0; i < numCalls; ++i) {
+            [[maybe_unused]] bool added = d.contrct.AddBid(Call(i));
+            assert(added);
+        }
+        position leader = Lefty(d.contrct.declarer);
+        for (int t = 0; t < numTricks; ++t) {
+            trick tr;
+            tr.SetLeadPos(leader);
+            tr.InitFromContract(d.contrct);
+            for (int k = 0; k < numPlayers; ++k)
+                tr.PlayCard(TrickCard(t, k));
+            d.AddTrick(tr);
+            leader = *tr.WonBy();
+        }
+        return d;
+    }
+
+    int Owner(int card) const { return (owners[card / 4] >> (2 * (card % 4))) & 3; }
+
+    std::uint64_t HandMask(position p) const {
+        std::uint64_t m = 0;
+        for (int card = 0; card < CardsInDeck; ++card)
+            if (Owner(card) == static_cast<int>(p))
+                m |= std::uint64_t{1} << card;
+        return m;
+    }
+
+    position GetDealer() const { return static_cast<position>(dealerAndVul & 3); }
+
+    vulnerability GetVulnerability() const { return static_cast<vulnerability>(dealerAndVul >> 2); }
+
+    int NumCalls() const { return numCalls; }
+
+    // Call i of the auction, the first call being 0
+    bid Call(int i) const {
+        assert(i >= 0 && i < numCalls);
+        return bid::FromCallIndex(Get6(calls, i));
+    }
+
+    int NumTricks() const { return numTricks; }
+
+    // Card k of trick t in the order played, the lead being 0
+    Card TrickCard(int t, int k) const {
+        assert(t >= 0 && t < numTricks && k >= 0 && k < numPlayers);
+        return Card{static_cast<CardInt>(Get6(play, t * numPlayers + k))};
+    }
+
+    bool operator==(const compactdeal &) const = default;
+};
+
+static_assert(std::is_trivially_copyable_v<compactdeal> && sizeof(compactdeal) < 128);
+
+// A deal from a counter_rng stream whose hands are only sorted when asked for.
+// Cheap queries (points, suit lengths) read the shuffled deck directly.
+class lazydeal {
+  private:
+    Deck deck;
+    std::uint64_t index = 0;
+    mutable std::array<Hand, numPlayers> hands;
+    mutable unsigned char ready = 0;
+
+    auto Seat(position p) const {
+        return std::span<const CardInt, CardsInHand>(deck.data() + static_cast<int>(p) * CardsInHand,
+                                                     CardsInHand);
+    }
+
+  public:
+    void Generate(counter_rng &rng, std::uint64_t idx) {
+        rng.Seek(idx);
+        index = idx;
+        deck = OrderedDeck();
+        ShuffleDeck(deck, rng);
+        ready = 0;
+    }
+
+    std::uint64_t GetIndex() const { return index; }
+
+    const Hand &GetHand(position p) const {
+        int i = static_cast<int>(p);
+        if (!(ready & (1 << i))) {
+            std::ranges::transform(Seat(p), hands[i].crd.begin(), [](CardInt c) { return Card{c}; });
+            hands[i].SetSuits();
+            ready |= 1 << i;
+        }
+        return hands[i];
+    }
+
+    int PointCount(position p) const {
+        int count = 0;
+        for (CardInt c : Seat(p))
+            count += Card{c}.PointCount();
+        return count;
+    }
+
+    int SuitLength(position p, suit s) const {
+        assert(IsValid(s));
+        return std::ranges::count_if(Seat(p), [s](CardInt c) { return Card{c}.Suit() == s; });
+    }
+
+    deal ToDeal() const { return deal(deck); }
+
+    std::string to_link() const { return ToDeal().to_link(); }
+};
+
+// Input range over deals [first, first + count) of a stream. The element is a
+// single buffer that is regenerated in place on each increment, so it composes
+// with std::views::filter/transform/take without allocating per deal.
+class dealsource : public std::ranges::view_interface<dealsource> {
+  private:
+    counter_rng rng;
+    std::uint64_t next;
+    std::uint64_t last;
+    lazydeal current;
+
+  public:
+    class iterator {
+      private:
+        dealsource *src = nullptr;
+
+      public:
+        using value_type = lazydeal;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+        explicit iterator(dealsource *s) : src(s) {}
+
+        const lazydeal &operator*() const { return src->current; }
+        const lazydeal *operator->() const { return &src->current; }
+
+        iterator &operator++() {
+            if (++src->next < src->last)
+                src->current.Generate(src->rng, src->next);
+            return *this;
+        }
+        void operator++(int) { ++*this; }
+
+        bool AtEnd() const { return src->next >= src->last; }
+
+        friend bool operator==(const iterator &it, std::default_sentinel_t) { return it.AtEnd(); }
+    };
+
+    dealsource() : dealsource(0, 0, 0, 0) {}
+
+    dealsource(std::uint64_t seed, std::uint32_t stream, std::uint64_t first = 0,
+               std::uint64_t count = UINT64_MAX)
+        : rng(seed, stream), next(first), last(first + std::min(count, UINT64_MAX - first)) {}
+
+    iterator begin() {
+        if (next < last)
+            current.Generate(rng, next);
+        return iterator(this);
+    }
+
+    std::default_sentinel_t end() const { return {}; }
 };
 } // namespace cards
@@ -0,0 +1,561 @@
+module;
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <iterator>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+export module database;
+
+import cards;
+import boards;
+import stats;
+import workers;
+
+export namespace database {
+using cards::position;
+
+// A set of record numbers, compressed in the manner of Roaring bitmaps: the
+// numbers are split into chunks of 65536 by their high 16 bits, and each
+// chunk holds either a sorted array of the low 16 bits or, once that would
+// be bigger, a 65536 bit bitmap.
+class bitmap {
+  private:
+    enum { ArrayLimit = 4096, Words = 65536 / 64 };
+
+    struct chunk {
+        std::uint16_t key = 0;
+        std::uint32_t count = 0;
+        std::vector<std::uint16_t> values; // while count <= ArrayLimit
+        std::vector<std::uint64_t> words;  // otherwise
+
+        bool IsArray() const { return words.empty(); }
+
+        bool Contains(std::uint16_t low) const {
+            if (IsArray())
+                return std::binary_search(values.begin(), values.end(), low);
+            return words[low >> 6] >> (low & 63) & 1;
+        }
+
+        void ToWords() {
+            words.assign(Words, 0);
+            for (auto v : values)
+                words[v >> 6] |= std::uint64_t{1} << (v & 63);
+            values.clear();
+            values.shrink_to_fit();
+        }
+
+        void ToArray() {
+            values.clear();
+            values.reserve(count);
+            for (int w = 0; w < Words; ++w) {
+                for (std::uint64_t bits = words[w]; bits; bits &= bits - 1)
+                    values.push_back(static_cast<std::uint16_t>(w * 64 + std::countr_zero(bits)));
+            }
+            words.clear();
+            words.shrink_to_fit();
+        }
+
+        void Fit() {
+            if (IsArray() && count > ArrayLimit)
+                ToWords();
+            else if (!IsArray() && count <= ArrayLimit)
+                ToArray();
+        }
+
+        template <typename F> void ForEach(F &&fn) const {
+            std::uint32_t high = std::uint32_t{key} << 16;
+            if (IsArray()) {
+                for (auto v : values)
+                    fn(high | v);
+                return;
+            }
+            for (int w = 0; w < Words; ++w) {
+                for (std::uint64_t bits = words[w]; bits; bits &= bits - 1)
+                    fn(high | static_cast<std::uint32_t>(w * 64 + std::countr_zero(bits)));
+            }
+        }
+    };
+
+    std::vector<chunk> chunks;
+
+    static chunk And(const chunk &a, const chunk &b) {
+        chunk out;
+        out.key = a.key;
+        if (a.IsArray() || b.IsArray()) {
+            const chunk &small = a.IsArray() ? a : b;
+            const chunk &other = a.IsArray() ? b : a;
+            for (auto v : small.values) {
+                if (other.Contains(v))
+                    out.values.push_back(v);
+            }
+            out.count = out.values.size();
+            return out;
+        }
+        out.words.resize(Words);
+        for (int w = 0; w < Words; ++w) {
+            out.words[w] = a.words[w] & b.words[w];
+            out.count += std::popcount(out.words[w]);
+        }
+        out.Fit();
+        return out;
+    }
+
+    static chunk Or(const chunk &a, const chunk &b) {
+        chunk out;
+        out.key = a.key;
+        if (a.IsArray() && b.IsArray()) {
+            std::ranges::set_union(a.values, b.values, std::back_inserter(out.values));
+            out.count = out.values.size();
+            out.Fit();
+            return out;
+        }
+        out.words.assign(Words, 0);
+        for (const chunk *c : {&a, &b}) {
+            if (c->IsArray()) {
+                for (auto v : c->values)
+                    out.words[v >> 6] |= std::uint64_t{1} << (v & 63);
+            } else {
+                for (int w = 0; w < Words; ++w)
+                    out.words[w] |= c->words[w];
+            }
+        }
+        for (auto w : out.words)
+            out.count += std::popcount(w);
+        return out;
+    }
+
+  public:
+    // Numbers must be added in increasing order, as they are when indexing records
+    void Add(std::uint32_t n) {
+        auto key = static_cast<std::uint16_t>(n >> 16);
+        auto low = static_cast<std::uint16_t>(n);
+        if (chunks.empty() || chunks.back().key != key) {
+            assert(chunks.empty() || chunks.back().key < key);
+            chunks.emplace_back().key = key;
+        }
+        chunk &c = chunks.back();
+        if (c.IsArray()) {
+            assert(c.values.empty() || c.values.back() < low);
+            c.values.push_back(low);
+        } else {
+            c.words[low >> 6] |= std::uint64_t{1} << (low & 63);
+        }
+        ++c.count;
+        if (c.IsArray() && c.count > ArrayLimit)
+            c.ToWords();
+    }
+
+    // Records [0, n)
+    static bitmap All(std::uint32_t n) {
+        bitmap b;
+        for (std::uint32_t i = 0; i < n; ++i)
+            b.Add(i);
+        return b;
+    }
+
+    bool Contains(std::uint32_t n) const {
+        auto key = static_cast<std::uint16_t>(n >> 16);
+        auto it = std::ranges::lower_bound(chunks, key, {}, &chunk::key);
+        return it != chunks.end() && it->key == key && it->Contains(static_cast<std::uint16_t>(n));
+    }
+
+    std::uint64_t Count() const {
+        std::uint64_t total = 0;
+        for (const auto &c : chunks)
+            total += c.count;
+        return total;
+    }
+
+    bool empty() const { return chunks.empty(); }
+
+    template <typename F> void ForEach(F &&fn) const {
+        for (const auto &c : chunks)
+            c.ForEach(fn);
+    }
+
+    std::vector<std::uint32_t> ToVector() const {
+        std::vector<std::uint32_t> out;
+        out.reserve(Count());
+        ForEach([&out](std::uint32_t n) { out.push_back(n); });
+        return out;
+    }
+
+    friend bitmap operator&(const bitmap &a, const bitmap &b) {
+        bitmap out;
+        auto i = a.chunks.begin();
+        auto j = b.chunks.begin();
+        while (i != a.chunks.end() && j != b.chunks.end()) {
+            if (i->key < j->key) {
+                ++i;
+            } else if (j->key < i->key) {
+                ++j;
+            } else {
+                chunk c = And(*i++, *j++);
+                if (c.count)
+                    out.chunks.push_back(std::move(c));
+            }
+        }
+        return out;
+    }
+
+    friend bitmap operator|(const bitmap &a, const bitmap &b) {
+        bitmap out;
+        auto i = a.chunks.begin();
+        auto j = b.chunks.begin();
+        while (i != a.chunks.end() || j != b.chunks.end()) {
+            if (j == b.chunks.end() || (i != a.chunks.end() && i->key < j->key))
+                out.chunks.push_back(*i++);
+            else if (i == a.chunks.end() || j->key < i->key)
+                out.chunks.push_back(*j++);
+            else
+                out.chunks.push_back(Or(*i++, *j++));
+        }
+        return out;
+    }
+
+    bool operator==(const bitmap &o) const { return ToVector() == o.ToVector(); }
+
+    // Chunk count, then each chunk's key, count and contents
+    void Save(std::ostream &os) const {
+        auto put = [&os](const auto *data, std::size_t n) {
+            os.write(reinterpret_cast<const char *>(data), n * sizeof(*data));
+        };
+        auto size = static_cast<std::uint32_t>(chunks.size());
+        put(&size, 1);
+        for (const auto &c : chunks) {
+            put(&c.key, 1);
+            put(&c.count, 1);
+            if (c.IsArray())
+                put(c.values.data(), c.values.size());
+            else
+                put(c.words.data(), c.words.size());
+        }
+    }
+
+    bool Load(std::istream &is) {
+        auto get = [&is](auto *data, std::size_t n) {
+            return static_cast<bool>(is.read(reinterpret_cast<char *>(data), n * sizeof(*data)));
+        };
+        // There are only 65536 keys, so any more chunks mean a damaged file
+        std::uint32_t size;
+        if (!get(&size, 1) || size > 65536)
+            return false;
+        chunks.assign(size, {});
+        for (auto &c : chunks) {
+            if (!get(&c.key, 1) || !get(&c.count, 1) || c.count == 0 || c.count > 65536)
+                return false;
+            if (c.count <= ArrayLimit) {
+                c.values.resize(c.count);
+                if (!get(c.values.data(), c.count))
+                    return false;
+            } else {
+                c.words.resize(Words);
+                if (!get(c.words.data(), Words))
+                    return false;
+            }
+        }
+        return true;
+    }
+};
+
+// Derived columns, one small value per record each, all of them indexed
+enum column {
+    PointsColumn = 0,                                  // one per seat
+    LengthColumn = PointsColumn + cards::numPlayers,  // one per seat and suit
+    PatternColumn = LengthColumn + cards::numPlayers * cards::SuitsInDeck, // one per seat
+    ContractColumn = PatternColumn + cards::numPlayers,
+    DeclarerColumn,
+    DoubledColumn,
+    VulnerabilityColumn,
+    DealerColumn,
+    Columns
+};
+
+inline int PointsOf(position p) { return PointsColumn + static_cast<int>(p); }
+
+inline int LengthOf(position p, cards::suit s) {
+    return LengthColumn + static_cast<int>(p) * cards::SuitsInDeck + static_cast<int>(s);
+}
+
+inline int PatternOf(position p) { return PatternColumn + static_cast<int>(p); }
+
+// Values a column can hold, as bits of a set
+enum { MaxValues = 64, NoContract = MaxValues - 1, NoDeclarer = cards::numPlayers };
+
+// The 39 shape patterns, longest suit first, in order; a pattern column holds
+// the position of the pattern in this list
+inline const std::vector<stats::pattern> &Patterns() {
+    static const std::vector<stats::pattern> all = [] {
+        std::vector<stats::pattern> out;
+        for (const auto &entry : stats::Exact().Patterns())
+            out.push_back(entry.first);
+        return out;
+    }();
+    return all;
+}
+
+inline int PatternValue(stats::pattern p) {
+    auto it = std::ranges::lower_bound(Patterns(), p);
+    assert(it != Patterns().end() && *it == p);
+    return static_cast<int>(it - Patterns().begin());
+}
+
+constexpr std::uint64_t Range(int low, int high) {
+    std::uint64_t set = 0;
+    for (int v = std::max(low, 0); v <= std::min(high, MaxValues - 1); ++v)
+        set |= std::uint64_t{1} << v;
+    return set;
+}
+
+// Conditions on columns, all of which must hold: each allows a set of values
+class query {
+  private:
+    std::vector<std::pair<int, std::uint64_t>> conditions;
+
+  public:
+    const std::vector<std::pair<int, std::uint64_t>> &Conditions() const { return conditions; }
+
+    query &Where(int col, std::uint64_t values) {
+        assert(col >= 0 && col < Columns);
+        conditions.emplace_back(col, values);
+        return *this;
+    }
+
+    query &Points(position p, int low, int high) { return Where(PointsOf(p), Range(low, high)); }
+
+    query &Length(position p, cards::suit s, int low, int high) {
+        return Where(LengthOf(p, s), Range(low, high));
+    }
+
+    query &Pattern(position p, stats::pattern pat) {
+        return Where(PatternOf(p), std::uint64_t{1} << PatternValue(pat));
+    }
+
+    query &Contract(const cards::bid &b) {
+        return Where(ContractColumn, std::uint64_t{1} << b.CallIndex());
+    }
+
+    // Any game or slam: 3NT, 4 of a major or 5 of a minor and up
+    query &Game() {
+        std::uint64_t set = 0;
+        for (int i = 0; i < cards::bid::NumCalls; ++i) {
+            cards::bid b = cards::bid::FromCallIndex(i);
+            if (!b.IsABid())
+                continue;
+            int need = b.IsNoTrumps() ? 3 : (*b.bidSuit() >= cards::suit::hearts ? 4 : 5);
+            if (*b.bidSize() >= need)
+                set |= std::uint64_t{1} << i;
+        }
+        return Where(ContractColumn, set);
+    }
+
+    query &Declarer(position p) { return Where(DeclarerColumn, std::uint64_t{1} << static_cast<int>(p)); }
+
+    // Declared by p or p's partner
+    query &DeclaringSide(position p) {
+        return Where(DeclarerColumn, std::uint64_t{1} << static_cast<int>(p) |
+                                         std::uint64_t{1} << static_cast<int>(cards::OffsetPosition(p, 2)));
+    }
+
+    query &Vulnerable(cards::vulnerability v) {
+        return Where(VulnerabilityColumn, std::uint64_t{1} << static_cast<int>(v));
+    }
+};
+
+// Deals stored by column: the hands and board numbers as they are, plus the
+// derived columns and a bitmap of the records holding each value of each
+// one. A query ORs the bitmaps of the values each condition allows and
+// intersects the results, smallest first, so only matching records are read.
+class dealbase {
+  private:
+    std::vector<std::uint16_t> numbers;
+    std::array<std::vector<std::uint64_t>, cards::numPlayers> hands;
+    std::array<std::vector<std::uint8_t>, Columns> values;
+    std::array<std::array<bitmap, MaxValues>, Columns> index;
+
+    static constexpr char Magic[8] = {'D', 'E', 'A', 'L', 'B', 'A', 'S', '1'};
+
+    void Derive(std::size_t r, const boards::board &b) {
+        const cards::deal &d = b.d;
+        numbers[r] = static_cast<std::uint16_t>(b.number);
+        for (int p = 0; p < cards::numPlayers; ++p) {
+            std::uint64_t m = 0;
+            for (const auto &cd : d.hands[p].crd)
+                m |= std::uint64_t{1} << cards::NotPlayed(cd.crd);
+            hands[p][r] = m;
+            auto seat = static_cast<position>(p);
+            values[PointsOf(seat)][r] = static_cast<std::uint8_t>(cards::MaskPointCount(m));
+            std::array<int, cards::SuitsInDeck> lengths;
+            for (int s = 0; s < cards::SuitsInDeck; ++s) {
+                lengths[s] = std::popcount(m & cards::SuitMask(static_cast<cards::suit>(s)));
+                values[LengthOf(seat, static_cast<cards::suit>(s))][r] =
+                    static_cast<std::uint8_t>(lengths[s]);
+            }
+            values[PatternOf(seat)][r] = static_cast<std::uint8_t>(PatternValue(stats::PatternOf(lengths)));
+        }
+        const cards::contract &c = d.contrct;
+        int contract = NoContract;
+        int declarer = NoDeclarer;
+        int doubled = 0;
+        if (c.finalContract.IsValid()) {
+            contract = c.finalContract.CallIndex();
+            if (c.finalContract.IsABid()) {
+                declarer = static_cast<int>(c.declarer);
+                // the latest call comes first
+                for (auto it = c.bids.begin(); it != c.bids.end() && !it->IsABid(); ++it) {
+                    if (it->IsDouble() || it->IsReDouble()) {
+                        doubled = it->IsReDouble() ? 2 : 1;
+                        break;
+                    }
+                }
+            }
+        }
+        values[ContractColumn][r] = static_cast<std::uint8_t>(contract);
+        values[DeclarerColumn][r] = static_cast<std::uint8_t>(declarer);
+        values[DoubledColumn][r] = static_cast<std::uint8_t>(doubled);
+        values[VulnerabilityColumn][r] = static_cast<std::uint8_t>(d.GetVulnerability());
+        values[DealerColumn][r] = static_cast<std::uint8_t>(c.GetDealer());
+    }
+
+    // Records only ever go on the end, so indexing the new ones just appends
+    // them to the bitmaps of their values
+    void IndexFrom(std::uint32_t first, unsigned threads) {
+        workers::ParallelFor(
+            Columns, threads,
+            [this, first](std::size_t col, unsigned) {
+                for (std::uint32_t r = first; r < values[col].size(); ++r)
+                    index[col][values[col][r]].Add(r);
+            },
+            1);
+    }
+
+  public:
+    std::uint32_t size() const { return static_cast<std::uint32_t>(numbers.size()); }
+
+    void Add(const std::vector<boards::board> &boards, unsigned threads = workers::DefaultThreads()) {
+        std::size_t first = numbers.size();
+        assert(first + boards.size() <= UINT32_MAX);
+        numbers.resize(first + boards.size());
+        for (auto &h : hands)
+            h.resize(numbers.size());
+        for (auto &v : values)
+            v.resize(numbers.size());
+        workers::ParallelFor(boards.size(), threads,
+                             [&](std::size_t i, unsigned) { Derive(first + i, boards[i]); });
+        IndexFrom(static_cast<std::uint32_t>(first), threads);
+    }
+
+    int Value(int col, std::uint32_t record) const { return values[col][record]; }
+
+    std::uint64_t Hand(std::uint32_t record, position p) const {
+        return hands[static_cast<int>(p)][record];
+    }
+
+    int Number(std::uint32_t record) const { return numbers[record]; }
+
+    // The records holding one value of a column
+    const bitmap &Index(int col, int value) const { return index[col][value]; }
+
+    bitmap Match(const query &q) const {
+        std::vector<bitmap> parts;
+        for (const auto &[col, set] : q.Conditions()) {
+            bitmap any;
+            for (std::uint64_t s = set; s; s &= s - 1)
+                any = any | index[col][std::countr_zero(s)];
+            parts.push_back(std::move(any));
+        }
+        if (parts.empty())
+            return bitmap::All(size());
+        std::ranges::sort(parts, {}, &bitmap::Count);
+        bitmap out = std::move(parts[0]);
+        for (std::size_t i = 1; i < parts.size() && !out.empty(); ++i)
+            out = out & parts[i];
+        return out;
+    }
+
+    std::uint64_t Count(const query &q) const { return Match(q).Count(); }
+
+    std::vector<std::uint32_t> Find(const query &q) const { return Match(q).ToVector(); }
+
+    // Matching records for which pred(record) also holds, reading only those
+    template <typename Pred> std::vector<std::uint32_t> Find(const query &q, Pred &&pred) const {
+        std::vector<std::uint32_t> out;
+        Match(q).ForEach([&](std::uint32_t r) {
+            if (pred(r))
+                out.push_back(r);
+        });
+        return out;
+    }
+
+    // The deal of a record, without its auction or play
+    boards::board Board(std::uint32_t record) const {
+        boards::binaryrecord rec{};
+        rec[0] = static_cast<unsigned char>(numbers[record] & 0xff);
+        rec[1] = static_cast<unsigned char>(numbers[record] >> 8);
+        rec[2] = values[DealerColumn][record];
+        rec[3] = values[VulnerabilityColumn][record];
+        for (int p = 0; p < cards::numPlayers; ++p) {
+            for (std::uint64_t m = hands[p][record]; m; m &= m - 1) {
+                int c = std::countr_zero(m);
+                rec[4 + c / 4] |= static_cast<unsigned char>(p << (2 * (c % 4)));
+            }
+        }
+        return boards::FromBinary(rec);
+    }
+
+    // The columns one after another, then the indexes, in the machine's byte order
+    void Save(std::ostream &os) const {
+        auto put = [&os](const auto &v) {
+            os.write(reinterpret_cast<const char *>(v.data()), v.size() * sizeof(v[0]));
+        };
+        os.write(Magic, sizeof(Magic));
+        std::uint32_t n = size();
+        os.write(reinterpret_cast<const char *>(&n), sizeof(n));
+        put(numbers);
+        for (const auto &h : hands)
+            put(h);
+        for (const auto &v : values)
+            put(v);
+        for (const auto &col : index)
+            for (const auto &b : col)
+                b.Save(os);
+    }
+
+    bool Load(std::istream &is) {
+        auto get = [&is](auto &v) {
+            return static_cast<bool>(is.read(reinterpret_cast<char *>(v.data()), v.size() * sizeof(v[0])));
+        };
+        char magic[sizeof(Magic)];
+        std::uint32_t n;
+        if (!is.read(magic, sizeof(magic)) || std::memcmp(magic, Magic, sizeof(Magic)) != 0 ||
+            !is.read(reinterpret_cast<char *>(&n), sizeof(n)))
+            return false;
+        numbers.resize(n);
+        for (auto &h : hands)
+            h.resize(n);
+        for (auto &v : values)
+            v.resize(n);
+        if (!get(numbers))
+            return false;
+        for (auto &h : hands)
+            if (!get(h))
+                return false;
+        for (auto &v : values)
+            if (!get(v))
+                return false;
+        for (auto &col : index)
+            for (auto &b : col)
+                if (!b.Load(is))
+                    return false;
+        return true;
+    }
+};
+} // namespace database
@@ -0,0 +1,183 @@
+module;
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+export module generator;
+
+import cards;
+import bidding;
+import boards;
+import workers;
+
+// Deal streams as dealgen writes them: deal(seed, 0, i) for i = 0, 1, ...,
+// kept when every seat meets its constraint and formatted as records into
+// blocks of consecutive indexes. A round of blocks is made across threads and
+// the blocks are then taken in order, so the records depend only on the seed,
+// the constraints and the format, never on the number of threads.
+export namespace generator {
+using cards::position;
+
+enum class format { text, lin, link, pbn, binary };
+
+using seatconstraints = std::array<std::optional<bidding::handconstraint>, cards::numPlayers>;
+using handmasks = std::array<std::uint64_t, cards::numPlayers>;
+
+// Deal `index` as it is shuffled, before its hands are sorted: 13 cards each
+// to south, west, north and east
+inline cards::Deck MakeDeck(std::uint64_t seed, std::uint64_t index) {
+    return cards::deal::ShuffledDeck(cards::counter_rng(seed, 0, index));
+}
+
+// Bit c of a seat's mask for card c
+inline handmasks HandMasks(const cards::Deck &deck) {
+    handmasks hands{};
+    for (int i = 0; i < cards::CardsInDeck; ++i)
+        hands[i / cards::CardsInHand] |= std::uint64_t{1} << deck[i];
+    return hands;
+}
+
+inline bool Matches(const seatconstraints &seats, const handmasks &hands) {
+    for (int p = 0; p < cards::numPlayers; ++p) {
+        if (seats[p] && !seats[p]->Matches(bidding::handfeatures(hands[p])))
+            return false;
+    }
+    return true;
+}
+
+inline int BoardNumber(std::uint64_t index) { return static_cast<int>(index % 16) + 1; }
+
+// Deal `index` as board index + 1, its dealer and vulnerability following the
+// standard 16 board cycle
+inline cards::deal MakeDeal(const cards::Deck &deck, std::uint64_t index) {
+    cards::deal d(deck);
+    d.contrct.SetDealer(boards::BoardDealer(BoardNumber(index)));
+    d.SetVulnerability(boards::BoardVulnerability(BoardNumber(index)));
+    return d;
+}
+
+inline cards::deal MakeDeal(std::uint64_t seed, std::uint64_t index) {
+    return MakeDeal(MakeDeck(seed, index), index);
+}
+
+// The pbn record, written straight from the hands: each suit's ranks from the top
+inline void AppendPbn(std::string &out, const handmasks &hands, std::uint64_t index, position dealer,
+                      cards::vulnerability v) {
+    char number[24];
+    out += "[Board \"";
+    out.append(number, std::to_chars(number, number + sizeof number, index + 1).ptr);
+    out += "\"]\n[Dealer \"";
+    out += boards::PositionChar(dealer);
+    out += "\"]\n[Vulnerable \"";
+    out += boards::VulnerabilityToPbn(v);
+    out += "\"]\n[Deal \"S:";
+    for (int p = 0; p < cards::numPlayers; ++p) {
+        if (p > 0)
+            out += ' ';
+        for (int s = cards::SuitsInDeck - 1; s >= 0; --s) {
+            for (std::uint64_t m = hands[p] & cards::SuitMask(static_cast<cards::suit>(s)); m;) {
+                int c = 63 - std::countl_zero(m);
+                out += cards::CardVal[c % cards::CardsInSuit];
+                m &= ~(std::uint64_t{1} << c);
+            }
+            if (s > 0)
+                out += '.';
+        }
+    }
+    out += "\"]\n\n";
+}
+
+inline void Append(std::string &out, const cards::deal &d, std::uint64_t index, format fmt) {
+    switch (fmt) {
+    case format::text:
+        out += d.to_string();
+        out += '\n';
+        break;
+    case format::lin:
+        out += d.to_lin();
+        out += '\n';
+        break;
+    case format::link:
+        out += d.to_link();
+        out += '\n';
+        break;
+    case format::pbn: {
+        handmasks hands{};
+        for (int p = 0; p < cards::numPlayers; ++p) {
+            for (const auto &cd : d.hands[p].crd)
+                hands[p] |= std::uint64_t{1} << cards::NotPlayed(cd.crd);
+        }
+        AppendPbn(out, hands, index, d.contrct.GetDealer(), d.GetVulnerability());
+        break;
+    }
+    case format::binary: {
+        // compactdeal records in host byte order; compactdeal::ToDeal reads them back
+        auto c = cards::compactdeal::FromDeal(d);
+        out.append(reinterpret_cast<const char *>(&*c), sizeof *c);
+        break;
+    }
+    }
+}
+
+enum { BlockDeals = 4096 };
+
+// One block of deal indexes: the records of those that qualified, and where each ends
+struct block {
+    std::string text;
+    std::vector<std::uint32_t> ends;
+
+    // Cuts the block back to its first `wanted` records; returns how many are left
+    std::uint64_t Trim(std::uint64_t wanted) {
+        std::uint64_t keep = std::min<std::uint64_t>(ends.size(), wanted);
+        ends.resize(keep);
+        text.resize(keep ? ends.back() : 0);
+        return keep;
+    }
+};
+
+// Fills bl with the records of the deals in [first, last) that meet seats,
+// reusing the block's storage. Deals are tested on their card masks, and pbn
+// and binary records are written from them too; only the other formats sort
+// the cards into a cards::deal.
+inline void FillBlock(block &bl, std::uint64_t seed, std::uint64_t first, std::uint64_t last,
+                      const seatconstraints &seats, format fmt) {
+    bl.text.clear();
+    bl.ends.clear();
+    for (std::uint64_t i = first; i < last; ++i) {
+        cards::Deck deck = MakeDeck(seed, i);
+        handmasks hands = HandMasks(deck);
+        if (!Matches(seats, hands))
+            continue;
+        position dealer = boards::BoardDealer(BoardNumber(i));
+        cards::vulnerability v = boards::BoardVulnerability(BoardNumber(i));
+        if (fmt == format::pbn) {
+            AppendPbn(bl.text, hands, i, dealer, v);
+        } else if (fmt == format::binary) {
+            auto c = cards::compactdeal::FromHands(hands, dealer, v);
+            bl.text.append(reinterpret_cast<const char *>(&c), sizeof c);
+        } else {
+            Append(bl.text, MakeDeal(deck, i), i, fmt);
+        }
+        bl.ends.push_back(static_cast<std::uint32_t>(bl.text.size()));
+    }
+}
+
+// A round: block b gets the deals from first + b * blockDeals on, none at or
+// past limit. Returns the index after the last deal tried.
+inline std::uint64_t MakeRound(std::vector<block> &blocks, std::uint64_t seed, std::uint64_t first,
+                               std::uint64_t limit, const seatconstraints &seats, format fmt,
+                               unsigned threads = workers::DefaultThreads(),
+                               std::uint64_t blockDeals = BlockDeals) {
+    auto start = [&](std::size_t b) { return std::min(first + b * blockDeals, std::max(first, limit)); };
+    workers::ParallelFor(
+        blocks.size(), threads,
+        [&](std::size_t b, unsigned) { FillBlock(blocks[b], seed, start(b), start(b + 1), seats, fmt); }, 1);
+    return start(blocks.size());
+}
+} // namespace generator
@@ -0,0 +1,270 @@
+module;
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+export module partial;
+
+import cards;
+import workers;
+
+export namespace partial {
+using cards::position;
+using hands = std::array<std::uint64_t, cards::numPlayers>;
+
+// A deal with only some cards placed: known[p] holds the cards seat p is known
+// to have, and every seat ends up with 13
+struct partialdeal {
+    hands known{};
+
+    void Know(position p, std::uint64_t cardsHeld) { known[static_cast<int>(p)] |= cardsHeld; }
+
+    void Know(position p, const cards::Hand &h) {
+        for (const auto &cd : h.crd)
+            known[static_cast<int>(p)] |= std::uint64_t{1} << cards::NotPlayed(cd.crd);
+    }
+
+    std::uint64_t Placed() const { return known[0] | known[1] | known[2] | known[3]; }
+
+    std::uint64_t Unknown() const {
+        return ((std::uint64_t{1} << cards::CardsInDeck) - 1) & ~Placed();
+    }
+
+    int Missing(position p) const {
+        return cards::CardsInHand - std::popcount(known[static_cast<int>(p)]);
+    }
+
+    // No card placed twice and no seat over 13
+    bool IsValid() const {
+        int total = 0;
+        for (int p = 0; p < cards::numPlayers; ++p) {
+            if (Missing(static_cast<position>(p)) < 0)
+                return false;
+            total += std::popcount(known[p]);
+        }
+        return total == std::popcount(Placed());
+    }
+
+    bool Fits(const hands &h) const {
+        for (int p = 0; p < cards::numPlayers; ++p) {
+            if ((h[p] & known[p]) != known[p] || std::popcount(h[p]) != cards::CardsInHand)
+                return false;
+        }
+        return true;
+    }
+};
+
+// Bit i of m moved to the i'th set bit of pool (a software pdep)
+constexpr std::uint64_t Deposit(std::uint64_t m, std::uint64_t pool) {
+    std::uint64_t out = 0;
+    for (; m && pool; m >>= 1, pool &= pool - 1) {
+        if (m & 1)
+            out |= pool & -pool;
+    }
+    return out;
+}
+
+// k of the low n bits: the combination of colex rank r
+constexpr std::uint64_t UnrankCombination(std::uint64_t r, int n, int k) {
+    std::uint64_t m = 0;
+    for (int i = k; i > 0; --i) {
+        int c = i - 1;
+        while (c + 1 < n && cards::Binomial(c + 1, i) <= r)
+            ++c;
+        r -= cards::Binomial(c, i);
+        m |= std::uint64_t{1} << c;
+        n = c;
+    }
+    return m;
+}
+
+// The next combination with the same number of bits in colex order (Gosper)
+constexpr std::uint64_t NextCombination(std::uint64_t m) {
+    std::uint64_t low = m & -m;
+    std::uint64_t ripple = m + low;
+    return ripple | (((m ^ ripple) >> 2) / low);
+}
+
+// Every completion of a partial deal, numbered from 0. The seats still
+// missing cards are filled in turn: the first takes a combination of the
+// unknown cards, the next a combination of what is left, and so on, with the
+// last seat's combination as the fastest moving digit of the number. Each
+// completion is equally likely, so its probability is 1 / size().
+class completions {
+  private:
+    partialdeal spec;
+    std::array<int, cards::numPlayers> seats{}; // those missing cards, in fill order
+    std::array<int, cards::numPlayers> pools{}; // size of each one's choice
+    std::array<std::uint64_t, cards::numPlayers> counts{};
+    int levels = 0;
+    std::uint64_t total = 1;
+
+  public:
+    explicit completions(const partialdeal &p) : spec(p) {
+        assert(p.IsValid());
+        int left = std::popcount(p.Unknown());
+        for (int s = 0; s < cards::numPlayers; ++s) {
+            int k = p.Missing(static_cast<position>(s));
+            if (k == 0)
+                continue;
+            seats[levels] = s;
+            pools[levels] = left;
+            counts[levels] = cards::Binomial(left, k);
+            assert(total <= UINT64_MAX / counts[levels]); // at most 39 cards unknown
+            total *= counts[levels];
+            left -= k;
+            ++levels;
+        }
+        assert(left == 0);
+    }
+
+    std::uint64_t size() const { return total; }
+
+    const partialdeal &Spec() const { return spec; }
+
+    hands Unrank(std::uint64_t index) const {
+        assert(index < total);
+        hands h = spec.known;
+        std::uint64_t pool = spec.Unknown();
+        std::array<std::uint64_t, cards::numPlayers> digits{};
+        for (int l = levels - 1; l >= 0; --l) {
+            digits[l] = index % counts[l];
+            index /= counts[l];
+        }
+        for (int l = 0; l < levels; ++l) {
+            std::uint64_t chosen = Deposit(UnrankCombination(digits[l], pools[l], Need(l)), pool);
+            h[seats[l]] |= chosen;
+            pool &= ~chosen;
+        }
+        return h;
+    }
+
+    // Calls fn(index, hands) for completions [first, first + count), stepping
+    // from one to the next instead of unranking each
+    template <typename F> void Walk(std::uint64_t first, std::uint64_t count, F &&fn) const {
+        assert(first <= total && count <= total - first);
+        if (count == 0)
+            return;
+        std::array<std::uint64_t, cards::numPlayers> masks{};
+        std::array<std::uint64_t, cards::numPlayers + 1> poolCards{};
+        std::uint64_t index = first;
+        for (int l = levels - 1; l >= 0; --l) {
+            masks[l] = UnrankCombination(index % counts[l], pools[l], Need(l));
+            index /= counts[l];
+        }
+        hands h = spec.known;
+        poolCards[0] = spec.Unknown();
+        auto fill = [&](int from) {
+            for (int l = from; l < levels; ++l) {
+                std::uint64_t chosen = Deposit(masks[l], poolCards[l]);
+                h[seats[l]] = spec.known[seats[l]] | chosen;
+                poolCards[l + 1] = poolCards[l] & ~chosen;
+            }
+        };
+        fill(0);
+        for (std::uint64_t i = first;;) {
+            fn(i, static_cast<const hands &>(h));
+            if (++i == first + count)
+                return;
+            int l = levels - 1;
+            for (; l >= 0; --l) {
+                masks[l] = NextCombination(masks[l]);
+                if (masks[l] < (std::uint64_t{1} << pools[l]))
+                    break;
+                masks[l] = (std::uint64_t{1} << Need(l)) - 1;
+            }
+            assert(l >= 0);
+            fill(l);
+        }
+    }
+
+  private:
+    int Need(int level) const { return cards::CardsInHand - std::popcount(spec.known[seats[level]]); }
+};
+
+// Calls fn(hands, worker) for every completion, split into runs across threads
+template <typename F>
+void ForEachCompletion(const partialdeal &p, F &&fn, unsigned threads = workers::DefaultThreads(),
+                       std::uint64_t runLength = 1 << 16) {
+    completions all(p);
+    std::uint64_t runs = (all.size() + runLength - 1) / runLength;
+    workers::ParallelFor(
+        runs, threads,
+        [&](std::size_t run, unsigned worker) {
+            std::uint64_t first = run * runLength;
+            all.Walk(first, std::min(runLength, all.size() - first),
+                     [&](std::uint64_t, const hands &h) { fn(h, worker); });
+        },
+        1);
+}
+
+// An exact probability: matching completions out of all of them
+struct exactcount {
+    std::uint64_t matching = 0;
+    std::uint64_t total = 0;
+
+    double Probability() const { return total ? static_cast<double>(matching) / total : 0.0; }
+};
+
+template <typename Pred>
+exactcount CountCompletions(const partialdeal &p, Pred &&pred,
+                            unsigned threads = workers::DefaultThreads()) {
+    threads = std::max(1u, threads);
+    std::vector<std::uint64_t> matching(threads);
+    ForEachCompletion(
+        p, [&](const hands &h, unsigned worker) { matching[worker] += pred(h) ? 1 : 0; }, threads);
+    exactcount c;
+    c.total = completions(p).size();
+    for (auto m : matching)
+        c.matching += m;
+    return c;
+}
+
+// Deals only the seats asked for, from the cards a partial deal leaves
+// unknown: a Fisher-Yates shuffle of the unknown cards stopped once those
+// seats are full. The other seats get just their known cards. Each sample
+// starts from the pool in card order, so it depends only on the stream.
+class seatsampler {
+  private:
+    partialdeal spec;
+    std::vector<int> seats;
+    std::array<cards::CardInt, cards::CardsInDeck> ordered;
+    int poolSize = 0;
+
+  public:
+    seatsampler(const partialdeal &p, std::initializer_list<position> wanted) : spec(p) {
+        assert(p.IsValid());
+        for (position s : wanted) {
+            assert(std::find(seats.begin(), seats.end(), static_cast<int>(s)) == seats.end());
+            seats.push_back(static_cast<int>(s));
+        }
+        for (std::uint64_t m = p.Unknown(); m; m &= m - 1)
+            ordered[poolSize++] = static_cast<cards::CardInt>(std::countr_zero(m));
+    }
+
+    explicit seatsampler(std::initializer_list<position> wanted) : seatsampler(partialdeal{}, wanted) {}
+
+    hands Sample(cards::counter_rng &rng) {
+        hands h = spec.known;
+        auto pool = ordered;
+        int i = 0;
+        for (int seat : seats) {
+            for (int k = spec.Missing(static_cast<position>(seat)); k > 0; --k, ++i) {
+                std::swap(pool[i], pool[i + rng.Below(poolSize - i)]);
+                h[seat] |= std::uint64_t{1} << pool[i];
+            }
+        }
+        return h;
+    }
+
+    cards::Hand SampleHand(cards::counter_rng &rng) {
+        assert(seats.size() == 1);
+        return cards::Hand::FromMask(Sample(rng)[seats[0]]);
+    }
+};
+} // namespace partial
@@ -0,0 +1,163 @@
+// replay: replays a corpus of recorded boards, one LIN line each, through the
+// auction, play and output code in a loop, and reports boards a second and
+// allocations a board. Against a baseline it fails, with exit status 1, when
+// either is worse than the tolerance allows or a board doesn't replay as
+// recorded.
+//
+//   replay [--corpus FILE] [--baseline FILE] [--tolerance F] [--seconds F]
+//          [--threads N] [--write-baseline FILE]
+//
+// The defaults are replay-corpus.lin and replay-baseline.json next to the
+// sources, a tolerance of 0.1 and 2 seconds, in the best of 5 rounds, on one
+// thread. Blank lines and lines starting with # in the corpus are skipped.
+// Boards a second depend on the machine: a baseline holds for the machine it
+// was written on, and should be rewritten with --write-baseline on another.
+// The build script only runs replay when asked to, with "./build replay".
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+import cards;
+import bench;
+
+// Every allocation through new is counted for the thread making it
+void *operator new(std::size_t size) {
+    ++bench::allocations;
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+struct options {
+    std::string corpus = "replay-corpus.lin";
+    std::string baseline = "replay-baseline.json";
+    std::string writeBaseline;
+    double tolerance = 0.1;
+    double seconds = 2;
+    unsigned threads = 1;
+};
+
+void Usage() {
+    std::cerr << "usage: replay [--corpus FILE] [--baseline FILE] [--tolerance F] [--seconds F]\n"
+                 "              [--threads N] [--write-baseline FILE]\n"
+                 "--baseline \"\" replays without comparing\n";
+}
+
+std::optional<options> ParseOptions(int argc, char **argv) {
+    options o;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        std::string value = argv[i + 1];
+        char *end = nullptr;
+        double number = std::strtod(value.c_str(), &end);
+        bool isNumber = !value.empty() && *end == '\0' && number >= 0;
+        if (arg == "--corpus")
+            o.corpus = value;
+        else if (arg == "--baseline")
+            o.baseline = value;
+        else if (arg == "--write-baseline")
+            o.writeBaseline = value;
+        else if (arg == "--tolerance" && isNumber && number < 1)
+            o.tolerance = number;
+        else if (arg == "--seconds" && isNumber)
+            o.seconds = number;
+        else if (arg == "--threads" && isNumber && number >= 1)
+            o.threads = static_cast<unsigned>(number);
+        else
+            return {};
+    }
+    if (argc % 2 == 0)
+        return {};
+    return o;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+    auto opts = ParseOptions(argc, argv);
+    if (!opts) {
+        Usage();
+        return 2;
+    }
+    const options &o = *opts;
+    bench::countingAllocations = true;
+
+    std::ifstream in(o.corpus);
+    if (!in) {
+        std::cerr << "replay: can't read " << o.corpus << "\n";
+        return 2;
+    }
+    std::vector<bench::recordedboard> corpus;
+    std::string line;
+    for (int n = 1; std::getline(in, line); ++n) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        auto b = bench::ParseRecordedBoard(line);
+        if (!b) {
+            std::cerr << o.corpus << ":" << n << ": not a board\n";
+            return 2;
+        }
+        corpus.push_back(std::move(*b));
+    }
+    if (corpus.empty()) {
+        std::cerr << "replay: no boards in " << o.corpus << "\n";
+        return 2;
+    }
+
+    // One pass to warm up and to size the timed rounds. The fastest round
+    // counts, since anything else on the machine only ever slows one down.
+    constexpr int Rounds = 5;
+    auto warmup = bench::ReplayCorpus(corpus, 1, o.threads);
+    std::uint64_t passes = std::max<std::uint64_t>(
+        1, static_cast<std::uint64_t>(o.seconds / Rounds / std::max(warmup.wallSeconds, 1e-6)));
+    bench::replayreport report;
+    for (int round = 0; round < Rounds; ++round) {
+        auto r = bench::ReplayCorpus(corpus, passes, o.threads);
+        if (round == 0 || r.BoardsPerSecond() > report.BoardsPerSecond())
+            report = r;
+    }
+    std::cout << report.to_string();
+
+    auto measured = bench::replaybaseline::FromReport(report, o.threads);
+    if (!o.writeBaseline.empty()) {
+        std::ofstream out(o.writeBaseline);
+        out << measured.to_json();
+        if (!out) {
+            std::cerr << "replay: can't write " << o.writeBaseline << "\n";
+            return 2;
+        }
+    }
+
+    std::optional<bench::replaybaseline> base;
+    if (!o.baseline.empty() && o.baseline != o.writeBaseline) {
+        std::ifstream b(o.baseline);
+        std::stringstream json;
+        json << b.rdbuf();
+        base = bench::replaybaseline::FromJson(json.str());
+        if (!base) {
+            std::cerr << "replay: can't read a baseline from " << o.baseline << "\n";
+            return 2;
+        }
+    }
+    std::vector<std::string> problems;
+    if (base)
+        problems = bench::CompareToBaseline(report, o.threads, *base, o.tolerance);
+    else if (report.mismatches > 0)
+        problems.push_back(std::to_string(report.mismatches) + " boards didn't replay as recorded");
+    for (const auto &p : problems)
+        std::cerr << "replay: " << p << "\n";
+    return problems.empty() ? 0 : 1;
+}
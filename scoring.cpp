@@ -0,0 +1,202 @@
+module;
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+export module scoring;
+
+import cards;
+import workers;
+
+export namespace scoring {
+using cards::position;
+using cards::vulnerability;
+
+enum { Undoubled = 0, Doubled = 1, Redoubled = 2 };
+
+// Duplicate score for the declaring side of level in strain (a suit or
+// notrumps) when declarer takes `tricks` tricks
+inline int ContractScore(int level, cards::suit strain, int doubled, bool vulnerable, int tricks) {
+    assert(level >= 1 && level <= cards::MaxBidSize && tricks >= 0 && tricks <= cards::CardsInHand);
+    int needed = level + 6;
+    int multiplier = 1 << doubled;
+    if (tricks < needed) {
+        int down = needed - tricks;
+        if (doubled == Undoubled)
+            return -down * (vulnerable ? 100 : 50);
+        int penalty = 0;
+        for (int d = 1; d <= down; ++d) {
+            if (vulnerable)
+                penalty += d == 1 ? 200 : 300;
+            else
+                penalty += d == 1 ? 100 : (d <= 3 ? 200 : 300);
+        }
+        return -penalty * multiplier / 2;
+    }
+    bool notrumps = strain == cards::suit::notrumps;
+    int perTrick = notrumps || strain >= cards::suit::hearts ? 30 : 20;
+    int contractPoints = (level * perTrick + (notrumps ? 10 : 0)) * multiplier;
+    int score = contractPoints;
+    score += contractPoints >= 100 ? (vulnerable ? 500 : 300) : 50;
+    if (level == 6)
+        score += vulnerable ? 750 : 500;
+    if (level == 7)
+        score += vulnerable ? 1500 : 1000;
+    int over = tricks - needed;
+    if (doubled == Undoubled)
+        score += over * perTrick;
+    else
+        score += over * (vulnerable ? 200 : 100) * multiplier / 2 + 50 * multiplier / 2;
+    return score;
+}
+
+inline bool IsVulnerable(vulnerability v, position declarer) {
+    bool northSouth = declarer == position::north || declarer == position::south;
+    return v == vulnerability::both ||
+           (northSouth ? v == vulnerability::northsouth : v == vulnerability::eastwest);
+}
+
+// One board's results by column. Contracts are call indexes, 0 for passed out.
+struct traveller {
+    vulnerability vul = vulnerability::neither;
+    std::vector<unsigned char> contract;
+    std::vector<unsigned char> doubled;
+    std::vector<unsigned char> declarer;
+    std::vector<unsigned char> tricks;
+    std::vector<int> nsScore;
+
+    std::size_t size() const { return nsScore.size(); }
+
+    void Add(const cards::bid &b, int dbl, position decl, int taken) {
+        contract.push_back(static_cast<unsigned char>(b.CallIndex()));
+        doubled.push_back(static_cast<unsigned char>(dbl));
+        declarer.push_back(static_cast<unsigned char>(decl));
+        tricks.push_back(static_cast<unsigned char>(taken));
+        int score = 0;
+        if (b.IsABid()) {
+            cards::suit strain = b.IsNoTrumps() ? cards::suit::notrumps : *b.bidSuit();
+            score = ContractScore(*b.bidSize(), strain, dbl, IsVulnerable(vul, decl), taken);
+            if (decl == position::east || decl == position::west)
+                score = -score;
+        }
+        nsScore.push_back(score);
+    }
+
+    void PassedOut() { Add(cards::bid::FromCallIndex(0), Undoubled, position::south, 0); }
+};
+
+// The IMP scale: IMPs for a difference are how many of these it reaches
+inline constexpr std::array<int, 24> ImpSteps = {20,   50,   90,   130,  170,  220,  270,  320,
+                                                 370,  430,  500,  600,  750,  900,  1100, 1300,
+                                                 1500, 1750, 2000, 2250, 2500, 3000, 3500, 4000};
+
+inline int Imps(int difference) {
+    int a = std::abs(difference);
+    int imps = static_cast<int>(std::ranges::upper_bound(ImpSteps, a) - ImpSteps.begin());
+    return difference < 0 ? -imps : imps;
+}
+
+// North-South matchpoint percentages: a point for each score beaten and half
+// for each tie, out of one fewer than the tables. With `tables` more than the
+// scores given, Neuberg's formula scales the result to that many.
+inline std::vector<double> Matchpoints(const std::vector<int> &scores, std::size_t tables = 0) {
+    std::size_t n = scores.size();
+    std::vector<double> out(n);
+    if (n == 0)
+        return out;
+    double full = static_cast<double>(std::max(tables, n));
+    if (full < 2) {
+        std::ranges::fill(out, 0.5);
+        return out;
+    }
+    std::vector<int> sorted = scores;
+    std::ranges::sort(sorted);
+    for (std::size_t i = 0; i < n; ++i) {
+        auto [low, high] = std::ranges::equal_range(sorted, scores[i]);
+        double points = (low - sorted.begin()) + 0.5 * (high - low - 1);
+        points = (points + 0.5) * full / n - 0.5;
+        out[i] = points / (full - 1);
+    }
+    return out;
+}
+
+// North-South cross-IMPs: each score IMPed against every other, averaged.
+// Sum_j Imps(s - s_j) is, for each step, the scores at least a step below s
+// less those at least a step above it, counted by binary search.
+inline std::vector<double> CrossImps(const std::vector<int> &scores) {
+    std::size_t n = scores.size();
+    std::vector<double> out(n);
+    if (n < 2)
+        return out;
+    std::vector<int> sorted = scores;
+    std::ranges::sort(sorted);
+    for (std::size_t i = 0; i < n; ++i) {
+        long total = 0;
+        for (int step : ImpSteps) {
+            total += std::ranges::upper_bound(sorted, scores[i] - step) - sorted.begin();
+            total -= sorted.end() - std::ranges::lower_bound(sorted, scores[i] + step);
+        }
+        out[i] = static_cast<double>(total) / (n - 1);
+    }
+    return out;
+}
+
+// The Butler datum: the mean North-South score once a `trim` fraction (and
+// at least one, with three or more scores) of the highest and lowest are
+// dropped, to the nearest 10
+inline int Datum(const std::vector<int> &scores, double trim = 0.1) {
+    std::size_t n = scores.size();
+    if (n == 0)
+        return 0;
+    std::vector<int> sorted = scores;
+    std::ranges::sort(sorted);
+    auto drop = static_cast<std::size_t>(n * trim);
+    if (n >= 3)
+        drop = std::max<std::size_t>(drop, 1);
+    drop = std::min(drop, (n - 1) / 2);
+    long sum = 0;
+    for (std::size_t i = drop; i < n - drop; ++i)
+        sum += sorted[i];
+    double mean = static_cast<double>(sum) / (n - 2 * drop);
+    return static_cast<int>(std::lround(mean / 10)) * 10;
+}
+
+inline std::vector<int> Butler(const std::vector<int> &scores, int datum) {
+    std::vector<int> out(scores.size());
+    std::ranges::transform(scores, out.begin(), [datum](int s) { return Imps(s - datum); });
+    return out;
+}
+
+// Every result of a board scored all three ways, from North-South's side
+struct boardscores {
+    std::vector<double> matchpoints;
+    std::vector<double> crossImps;
+    int datum = 0;
+    std::vector<int> butler;
+};
+
+inline boardscores ScoreBoard(const traveller &t, std::size_t tables = 0, double trim = 0.1) {
+    boardscores b;
+    b.matchpoints = Matchpoints(t.nsScore, tables);
+    b.crossImps = CrossImps(t.nsScore);
+    b.datum = Datum(t.nsScore, trim);
+    b.butler = Butler(t.nsScore, b.datum);
+    return b;
+}
+
+// Boards scored in parallel; tables is the most any board was played, for Neuberg
+inline std::vector<boardscores> ScoreEvent(const std::vector<traveller> &boards, double trim = 0.1,
+                                           unsigned threads = workers::DefaultThreads()) {
+    std::size_t tables = 0;
+    for (const auto &t : boards)
+        tables = std::max(tables, t.size());
+    std::vector<boardscores> out(boards.size());
+    workers::ParallelFor(boards.size(), threads,
+                         [&](std::size_t i, unsigned) { out[i] = ScoreBoard(boards[i], tables, trim); });
+    return out;
+}
+} // namespace scoring
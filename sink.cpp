@@ -0,0 +1,361 @@
+module;
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define SINK_IO_URING 1
+#endif
+
+export module sink;
+
+export namespace sink {
+
+// Enough of io_uring, through the raw system calls, to write a list of buffers
+// at the file's current position and wait for the result. Not usable (and the
+// writer falls back to writev) without kernel support for that, including
+// under seccomp filters that refuse the calls.
+class uring {
+  private:
+#ifdef SINK_IO_URING
+    int ringFd = -1;
+    void *sqRing = MAP_FAILED;
+    void *cqRing = MAP_FAILED;
+    std::size_t sqRingSize = 0;
+    std::size_t cqRingSize = 0;
+    io_uring_sqe *sqes = static_cast<io_uring_sqe *>(MAP_FAILED);
+    std::size_t sqesSize = 0;
+    io_uring_params params{};
+
+    unsigned &SqField(unsigned offset) {
+        return *reinterpret_cast<unsigned *>(static_cast<char *>(sqRing) + offset);
+    }
+    unsigned &CqField(unsigned offset) {
+        return *reinterpret_cast<unsigned *>(static_cast<char *>(cqRing) + offset);
+    }
+#endif
+
+  public:
+    uring() {
+#ifdef SINK_IO_URING
+        ringFd = static_cast<int>(syscall(__NR_io_uring_setup, 4, &params));
+        if (ringFd < 0 || !(params.features & IORING_FEAT_RW_CUR_POS)) {
+            Release();
+            return;
+        }
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+            sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+        sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd,
+                      IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED) {
+            Release();
+            return;
+        }
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+            cqRing = sqRing;
+        else
+            cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd,
+                          IORING_OFF_CQ_RING);
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void *s = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd,
+                       IORING_OFF_SQES);
+        sqes = static_cast<io_uring_sqe *>(s);
+        if (cqRing == MAP_FAILED || s == MAP_FAILED)
+            Release();
+#endif
+    }
+
+    uring(const uring &) = delete;
+    uring &operator=(const uring &) = delete;
+
+    ~uring() { Release(); }
+
+    void Release() {
+#ifdef SINK_IO_URING
+        if (sqes != MAP_FAILED)
+            munmap(sqes, sqesSize);
+        if (cqRing != MAP_FAILED && cqRing != sqRing)
+            munmap(cqRing, cqRingSize);
+        if (sqRing != MAP_FAILED)
+            munmap(sqRing, sqRingSize);
+        if (ringFd >= 0)
+            close(ringFd);
+        ringFd = -1;
+        sqRing = cqRing = MAP_FAILED;
+        sqes = static_cast<io_uring_sqe *>(MAP_FAILED);
+#endif
+    }
+
+    bool Available() const {
+#ifdef SINK_IO_URING
+        return ringFd >= 0;
+#else
+        return false;
+#endif
+    }
+
+    // Like writev: the bytes written or -errno
+    long WriteV(int fd, const iovec *iov, int count) {
+#ifdef SINK_IO_URING
+        assert(Available());
+        std::atomic_ref<unsigned> sqTail(SqField(params.sq_off.tail));
+        unsigned tail = sqTail.load(std::memory_order_relaxed);
+        unsigned index = tail & SqField(params.sq_off.ring_mask);
+        io_uring_sqe &sqe = sqes[index];
+        std::memset(&sqe, 0, sizeof sqe);
+        sqe.opcode = IORING_OP_WRITEV;
+        sqe.fd = fd;
+        sqe.addr = reinterpret_cast<std::uint64_t>(iov);
+        sqe.len = static_cast<unsigned>(count);
+        sqe.off = static_cast<std::uint64_t>(-1); // the current position, as write does
+        reinterpret_cast<unsigned *>(static_cast<char *>(sqRing) + params.sq_off.array)[index] = index;
+        sqTail.store(tail + 1, std::memory_order_release);
+
+        for (;;) {
+            long r = syscall(__NR_io_uring_enter, ringFd, 1, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (r >= 0)
+                break;
+            if (errno != EINTR)
+                return -errno;
+        }
+        std::atomic_ref<unsigned> cqHead(CqField(params.cq_off.head));
+        std::atomic_ref<unsigned> cqTail(CqField(params.cq_off.tail));
+        unsigned head = cqHead.load(std::memory_order_relaxed);
+        if (head == cqTail.load(std::memory_order_acquire))
+            return -EIO;
+        auto *cqes = reinterpret_cast<io_uring_cqe *>(static_cast<char *>(cqRing) + params.cq_off.cqes);
+        long res = cqes[head & CqField(params.cq_off.ring_mask)].res;
+        cqHead.store(head + 1, std::memory_order_release);
+        return res;
+#else
+        (void)fd, (void)iov, (void)count;
+        return -ENOSYS;
+#endif
+    }
+};
+
+// Formatted records go to a file descriptor from a background thread, so the
+// threads making them never wait on the disk. Producers hand over whole
+// buffers, each with a sequence number; buffers are written in sequence order
+// (a producer that doesn't care takes the next number with Submit(data)), as
+// many at a time as are ready, through io_uring when the kernel allows it and
+// writev otherwise. A producer blocks while maxQueued buffers are waiting,
+// unless its buffer is the next to be written. Written buffers are kept for
+// reuse by Buffer(). The descriptor is not closed.
+class writer {
+  private:
+    enum { MaxBatch = 64 };
+
+    int fd;
+    std::size_t bufferSize;
+    std::size_t maxQueued;
+    uring ring;
+
+    std::mutex lock;
+    std::condition_variable ready;   // the writer has work, or is closing
+    std::condition_variable drained; // a buffer has been written
+    std::map<std::uint64_t, std::string> queued;
+    std::vector<std::string> spare;
+    std::uint64_t nextSequence = 0; // handed out by Submit(data)
+    std::uint64_t nextWrite = 0;
+    bool closing = false;
+    bool failed = false;
+    std::atomic<std::uint64_t> bytes = 0;
+    std::atomic<std::uint64_t> writes = 0;
+    std::atomic<std::uint64_t> stalls = 0;
+    std::thread thread;
+
+    long WriteV(const iovec *iov, int count) {
+        if (ring.Available())
+            return ring.WriteV(fd, iov, count);
+        long r = ::writev(fd, iov, count);
+        return r < 0 ? -errno : r;
+    }
+
+    // Writes all of batch, resuming after short writes; false on an error
+    bool WriteAll(std::vector<std::string> &batch) {
+        std::array<iovec, MaxBatch> iov;
+        int count = 0;
+        for (auto &b : batch) {
+            if (!b.empty())
+                iov[count++] = {b.data(), b.size()};
+        }
+        iovec *first = iov.data();
+        while (count > 0) {
+            long r = WriteV(first, count);
+            if (r == -EINTR || r == -EAGAIN)
+                continue;
+            if (r <= 0)
+                return false;
+            ++writes;
+            bytes += static_cast<std::uint64_t>(r);
+            for (auto done = static_cast<std::size_t>(r); done > 0;) {
+                std::size_t n = std::min(done, first->iov_len);
+                first->iov_base = static_cast<char *>(first->iov_base) + n;
+                first->iov_len -= n;
+                done -= n;
+                if (first->iov_len == 0) {
+                    ++first;
+                    --count;
+                }
+            }
+        }
+        return true;
+    }
+
+    void Run() {
+        std::vector<std::string> batch;
+        std::unique_lock<std::mutex> hold(lock);
+        for (;;) {
+            ready.wait(hold, [this] { return closing || queued.contains(nextWrite); });
+            // At close, anything left is written in order, gaps or not
+            if (!queued.contains(nextWrite)) {
+                if (queued.empty())
+                    return;
+                nextWrite = queued.begin()->first;
+            }
+            while (batch.size() < MaxBatch) {
+                auto it = queued.find(nextWrite);
+                if (it == queued.end())
+                    break;
+                batch.push_back(std::move(it->second));
+                queued.erase(it);
+                ++nextWrite;
+            }
+            hold.unlock();
+            // After a failure the rest is dropped, but still taken off the queue
+            bool ok = !failed && WriteAll(batch);
+            hold.lock();
+            failed = !ok;
+            for (auto &b : batch) {
+                b.clear();
+                if (spare.size() < maxQueued + MaxBatch)
+                    spare.push_back(std::move(b));
+            }
+            batch.clear();
+            drained.notify_all();
+        }
+    }
+
+  public:
+    explicit writer(int fd, std::size_t bufferSize = 1 << 20, std::size_t maxQueued = 16, bool useRing = true)
+        : fd(fd), bufferSize(bufferSize), maxQueued(std::max<std::size_t>(maxQueued, 1)) {
+        if (!useRing)
+            ring.Release();
+        thread = std::thread([this] { Run(); });
+    }
+
+    writer(const writer &) = delete;
+    writer &operator=(const writer &) = delete;
+
+    ~writer() { Close(); }
+
+    std::size_t BufferSize() const { return bufferSize; }
+
+    bool UsingRing() const { return ring.Available(); }
+
+    // An empty buffer, with room for BufferSize() bytes when one can be reused
+    std::string Buffer() {
+        {
+            std::lock_guard<std::mutex> hold(lock);
+            if (!spare.empty()) {
+                std::string b = std::move(spare.back());
+                spare.pop_back();
+                return b;
+            }
+        }
+        std::string b;
+        b.reserve(bufferSize);
+        return b;
+    }
+
+    void Submit(std::uint64_t sequence, std::string &&data) {
+        std::unique_lock<std::mutex> hold(lock);
+        assert(!closing && sequence >= nextWrite && !queued.contains(sequence));
+        if (sequence != nextWrite && queued.size() >= maxQueued) {
+            ++stalls;
+            drained.wait(hold, [&] { return sequence == nextWrite || queued.size() < maxQueued; });
+        }
+        queued.emplace(sequence, std::move(data));
+        if (sequence == nextWrite)
+            ready.notify_one();
+    }
+
+    void Submit(std::string &&data) {
+        std::uint64_t sequence;
+        {
+            std::lock_guard<std::mutex> hold(lock);
+            sequence = nextSequence++;
+        }
+        Submit(sequence, std::move(data));
+    }
+
+    // Writes everything submitted and stops the writer thread. False if any
+    // write failed, in which case what followed it was dropped.
+    bool Close() {
+        {
+            std::lock_guard<std::mutex> hold(lock);
+            closing = true;
+        }
+        ready.notify_one();
+        if (thread.joinable())
+            thread.join();
+        return !failed;
+    }
+
+    std::uint64_t BytesWritten() const { return bytes; }
+    std::uint64_t Writes() const { return writes; }
+    // Times a producer waited for the writer to catch up
+    std::uint64_t Stalls() const { return stalls; }
+};
+
+// One thread's records for a writer: appended to a buffer, which is handed
+// over when full and on Flush or destruction
+class stream {
+  private:
+    writer &out;
+    std::string buffer;
+
+  public:
+    explicit stream(writer &w) : out(w), buffer(w.Buffer()) {}
+
+    stream(const stream &) = delete;
+    stream &operator=(const stream &) = delete;
+
+    ~stream() { Flush(); }
+
+    void Append(std::string_view record) {
+        buffer += record;
+        if (buffer.size() >= out.BufferSize())
+            Flush();
+    }
+
+    void Flush() {
+        if (buffer.empty())
+            return;
+        out.Submit(std::move(buffer));
+        buffer = out.Buffer();
+    }
+};
+} // namespace sink
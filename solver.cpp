@@ -0,0 +1,1317 @@
+module;
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <vector>
+
+export module solver;
+
+import cards;
+import boards;
+import bidding;
+import scoring;
+import workers;
+
+export namespace solver {
+using cards::position;
+
+enum { NoTrumps = cards::SuitsInDeck, MaxMoves = cards::CardsInHand };
+
+inline int Strain(cards::suit s) { return s == cards::suit::notrumps ? NoTrumps : static_cast<int>(s); }
+
+inline int Strain(const cards::bid &b) {
+    assert(b.IsABid());
+    return b.IsNoTrumps() ? NoTrumps : static_cast<int>(*b.bidSuit());
+}
+
+constexpr int CardSuit(int c) { return c / cards::CardsInSuit; }
+
+constexpr std::uint64_t Bit(int c) { return std::uint64_t{1} << c; }
+
+constexpr int HighestCard(std::uint64_t m) { return 63 - std::countl_zero(m); }
+
+constexpr bool Beats(int c, int winner, int trumps) {
+    if (CardSuit(c) == CardSuit(winner))
+        return c > winner;
+    return CardSuit(c) == trumps;
+}
+
+constexpr bool NorthSouth(int seat) { return seat % 2 == 0; }
+
+// Every hand's unplayed cards, south first
+using handmasks = std::array<std::uint64_t, cards::numPlayers>;
+
+constexpr std::uint64_t TrumpMask(int trumps) {
+    return trumps == NoTrumps ? 0 : cards::SuitMask(static_cast<cards::suit>(trumps));
+}
+
+// One suit of a run of winners: `from` leads its top card while that beats
+// both opponents' cards in the suit, or they have none left, and in a side
+// suit while no opponent holding trumps is void. The opponents follow low and
+// partner follows below the card led or, void, discards one of `spare`; a
+// partner who could only overtake ends the run. The played cards leave h and
+// those that won by their rank are added to deciding.
+inline int RunSuit(handmasks &h, int trumps, int from, int s, std::uint64_t spare, std::uint64_t &deciding) {
+    int with = (from + 2) % cards::numPlayers;
+    int lho = (from + 1) % cards::numPlayers;
+    int rho = (from + 3) % cards::numPlayers;
+    std::uint64_t suitMask = cards::SuitMask(static_cast<cards::suit>(s));
+    std::uint64_t trumpMask = s == trumps ? 0 : TrumpMask(trumps);
+    int tricks = 0;
+    for (std::uint64_t mine; (mine = h[from] & suitMask) != 0; ++tricks) {
+        if ((!(h[lho] & suitMask) && (h[lho] & trumpMask)) || (!(h[rho] & suitMask) && (h[rho] & trumpMask)))
+            break;
+        int top = HighestCard(mine);
+        std::uint64_t opps = (h[lho] | h[rho]) & suitMask;
+        std::uint64_t follow = h[with] & suitMask;
+        if ((opps && HighestCard(opps) > top) || (follow && std::countr_zero(follow) > top))
+            break;
+        if (opps || follow)
+            deciding |= Bit(top);
+        if (!follow && !(follow = h[with] & spare))
+            break;
+        h[from] &= ~Bit(top);
+        h[with] &= ~Bit(std::countr_zero(follow));
+        for (int o : {lho, rho}) {
+            if (h[o] & suitMask)
+                h[o] &= ~Bit(std::countr_zero(h[o] & suitMask));
+        }
+    }
+    return tricks;
+}
+
+// Tricks the side on lead can cash straight off. The leader runs its
+// winners, trumps first so that drawing them frees the side suits, and may
+// then lead a small card to partner's winners in one suit, which partner
+// runs. Partner discards only from suits the leader has run or can't lead,
+// never from that suit. The cards whose ranks counted are added to deciding.
+// Stops looking once `enough` tricks are found.
+inline int SureTricks(const handmasks &hands, int trumps, int leader, std::uint64_t &deciding,
+                      int enough = cards::CardsInHand) {
+    int partner = (leader + 2) % cards::numPlayers;
+    std::uint64_t oppCards = hands[(leader + 1) % cards::numPlayers] |
+                             hands[(leader + 3) % cards::numPlayers];
+    int best = 0;
+    std::uint64_t bestCards = 0;
+    for (int entry = -1; entry < cards::SuitsInDeck; ++entry) {
+        std::uint64_t entryMask = entry < 0 ? 0 : cards::SuitMask(static_cast<cards::suit>(entry));
+        if (entry >= 0) {
+            std::uint64_t win = hands[partner] & entryMask;
+            std::uint64_t opps = oppCards & entryMask;
+            if (!win || !(hands[leader] & entryMask) || (opps && HighestCard(opps) > HighestCard(win)))
+                continue;
+        }
+        handmasks h = hands;
+        std::uint64_t spare = 0;
+        for (int s = 0; s < cards::SuitsInDeck; ++s) {
+            std::uint64_t suitMask = cards::SuitMask(static_cast<cards::suit>(s));
+            if (!(h[leader] & suitMask))
+                spare |= suitMask;
+        }
+        int sure = 0;
+        std::uint64_t cardsRun = 0;
+        for (int i = 0; i < cards::SuitsInDeck; ++i) {
+            int s = trumps == NoTrumps ? i : (trumps + i) % cards::SuitsInDeck;
+            sure += RunSuit(h, trumps, leader, s, spare & ~entryMask, cardsRun);
+            spare |= cards::SuitMask(static_cast<cards::suit>(s));
+        }
+        if (entry >= 0 && (h[leader] & entryMask))
+            sure += RunSuit(h, trumps, partner, entry, ~std::uint64_t{0}, cardsRun);
+        if (sure > best) {
+            best = sure;
+            bestCards = cardsRun;
+            if (best >= enough)
+                break;
+        }
+    }
+    deciding |= bestCards;
+    return best;
+}
+
+// Tricks the side of `seat` is sure of from its top trumps: each card of
+// the side's top run of trumps wins the trick it is played to, and those
+// held by one hand are played to different tricks
+inline int TrumpTricks(const handmasks &hands, int trumps, int seat, std::uint64_t &deciding) {
+    std::uint64_t m = (hands[0] | hands[1] | hands[2] | hands[3]) & TrumpMask(trumps);
+    std::uint64_t side = hands[seat] | hands[(seat + 2) % cards::numPlayers];
+    std::uint64_t top = 0;
+    for (; m && (side & Bit(HighestCard(m))); m &= ~Bit(HighestCard(m)))
+        top |= Bit(HighestCard(m));
+    if (!top)
+        return 0;
+    deciding |= top;
+    return std::max(std::popcount(top & hands[seat]),
+                    std::popcount(top & hands[(seat + 2) % cards::numPlayers]));
+}
+
+// The most tricks the side of `seat` can win whatever the ranks: a side suit
+// card only wins when its suit is led, which happens at most once for each
+// card the longer hand of the side holds, and each trump wins at most once
+inline int LengthTricks(const handmasks &hands, int trumps, int seat) {
+    std::uint64_t a = hands[seat];
+    std::uint64_t b = hands[(seat + 2) % cards::numPlayers];
+    int most = 0;
+    for (int s = 0; s < cards::SuitsInDeck; ++s) {
+        std::uint64_t suitMask = cards::SuitMask(static_cast<cards::suit>(s));
+        int la = std::popcount(a & suitMask);
+        int lb = std::popcount(b & suitMask);
+        most += s == trumps ? la + lb : std::max(la, lb);
+    }
+    return std::min(most, std::popcount(a));
+}
+
+// Bounds on the tricks the side of `side` takes from the start of a trick
+// with `leader` on lead, from the sure winners of the side on lead, top
+// trumps and suit lengths. Some tens of nanoseconds; the solver cuts its
+// search with the same tests.
+struct trickbounds {
+    int lower = 0;
+    int upper = 0;
+};
+
+inline trickbounds BoundTricks(const handmasks &hands, int trumps, position leader, position side) {
+    int lead = static_cast<int>(leader);
+    int us = static_cast<int>(side);
+    int them = (us + 1) % cards::numPlayers;
+    int remaining = std::popcount(hands[lead]);
+    std::uint64_t unused = 0;
+    trickbounds b{0, remaining};
+    if (NorthSouth(lead) == NorthSouth(us))
+        b.lower = SureTricks(hands, trumps, lead, unused);
+    else
+        b.upper -= SureTricks(hands, trumps, lead, unused);
+    if (trumps != NoTrumps) {
+        b.lower = std::max(b.lower, TrumpTricks(hands, trumps, us, unused));
+        b.upper = std::min(b.upper, remaining - TrumpTricks(hands, trumps, them, unused));
+    }
+    b.upper = std::min(b.upper, LengthTricks(hands, trumps, us));
+    b.lower = std::max(b.lower, remaining - LengthTricks(hands, trumps, them));
+    return b;
+}
+
+inline trickbounds BoundTricks(const cards::deal &d, int trumps, position leader, position side) {
+    handmasks hands;
+    for (int p = 0; p < cards::numPlayers; ++p)
+        hands[p] = d.hands[p].Mask();
+    return BoundTricks(hands, trumps, leader, side);
+}
+
+// A point in the play: who holds what, and the cards of the trick in progress
+struct playstate {
+    std::array<std::uint64_t, cards::numPlayers> hands{};
+    int trumps = NoTrumps;
+    position leader = position::south;
+    std::array<int, cards::numPlayers> trick{};
+    int played = 0;
+
+    position ToMove() const {
+        return static_cast<position>((static_cast<int>(leader) + played) % cards::numPlayers);
+    }
+
+    // Tricks still to be won, including the one in progress
+    int TricksLeft() const { return std::popcount(hands[static_cast<int>(ToMove())]); }
+
+    std::uint64_t LegalCards() const {
+        std::uint64_t h = hands[static_cast<int>(ToMove())];
+        if (played > 0) {
+            std::uint64_t follow = h & cards::SuitMask(static_cast<cards::suit>(CardSuit(trick[0])));
+            if (follow)
+                return follow;
+        }
+        return h;
+    }
+
+    bool IsLegal(int c) const { return (LegalCards() & Bit(c)) != 0; }
+
+    // Plays c for the player to move and returns the winner if that ends the trick
+    std::optional<position> Play(int c) {
+        assert(IsLegal(c));
+        hands[static_cast<int>(ToMove())] &= ~Bit(c);
+        trick[played++] = c;
+        if (played < cards::numPlayers)
+            return {};
+        int win = 0;
+        for (int i = 1; i < cards::numPlayers; ++i) {
+            if (Beats(trick[i], trick[win], trumps))
+                win = i;
+        }
+        leader = static_cast<position>((static_cast<int>(leader) + win) % cards::numPlayers);
+        played = 0;
+        return leader;
+    }
+};
+
+// The unplayed cards of a deal with `leader` on lead to a fresh trick
+inline playstate MakePlayState(const cards::deal &d, int trumps, position leader) {
+    playstate ps;
+    for (int p = 0; p < cards::numPlayers; ++p)
+        ps.hands[p] = d.hands[p].Mask();
+    ps.trumps = trumps;
+    ps.leader = leader;
+    return ps;
+}
+
+inline trickbounds BoundTricks(const playstate &ps, position side) {
+    assert(ps.played == 0);
+    return BoundTricks(ps.hands, ps.trumps, ps.leader, side);
+}
+
+// Double dummy solver: a zero window alpha-beta search over whole tricks.
+// Results at the start of each trick go in a transposition table together
+// with the cards whose rank decided them (Haglund's "winning ranks"): an entry
+// applies to any position with the same suit lengths in each hand and the
+// same owners of the cards down to the lowest deciding card of each suit, so
+// lines differing only in small cards are searched once. An entry that
+// doesn't settle a position still names the lead that last cut its search,
+// which is tried first. Cards held in unbroken sequence are searched once, and
+// sure tricks for the side on lead cut the search short after the table is
+// looked up. Suit lengths and owners are kept up to date card by card. Keep
+// one per thread and reuse it; table entries stay valid across deals.
+class solver {
+  private:
+    // The owners of each suit's cards from the top down, 2 bits a card and a
+    // suit every SuitBits bits, clubs and diamonds in the first word. An entry
+    // keeps only its deciding cards' owners, and the mask covering them.
+    using ownerwords = std::array<std::uint64_t, 2>;
+
+    struct entry {
+        ownerwords owners;
+        ownerwords mask;
+        unsigned char lower; // north/south tricks from here
+        unsigned char upper;
+        signed char bestSuit = -1; // the lead that last cut the search, by suit
+        unsigned char bestIndex = 0; // and how many cards of the suit are above it
+    };
+
+    enum { SuitBits = 2 * cards::CardsInSuit };
+
+    // Entries are grouped by suit lengths, leader and trumps, in buckets found
+    // by open addressing; the whole table is dropped when it outgrows maxEntries
+    struct bucket {
+        std::uint64_t key = NoKey;
+        std::vector<entry> list;
+    };
+    static constexpr std::uint64_t NoKey = ~std::uint64_t{0};
+    std::vector<bucket> table = std::vector<bucket>(1024); // at most half full
+    std::size_t keys = 0;
+    std::size_t entries = 0;
+    std::size_t maxEntries;
+    std::array<std::uint64_t, cards::numPlayers> hands;
+    std::array<std::uint32_t, cards::SuitsInDeck> owners{}; // each suit's owners as in ownerwords
+    std::uint64_t lengths = 0;                               // a nibble a hand and suit, south's clubs on top
+    std::uint64_t trickCards = 0;
+    std::uint64_t nodes = 0;
+    int trumps = NoTrumps;
+    int hint = -1;    // a lead to try first, from a table entry that didn't settle the position
+    int lastCut = -1; // the lead that cut the last search at a trick start, or -1
+
+    std::uint64_t Remaining() const { return hands[0] | hands[1] | hands[2] | hands[3]; }
+
+    static int LengthShift(int seat, int s) {
+        return 4 * (cards::numPlayers * cards::SuitsInDeck - 1 - seat * cards::SuitsInDeck - s);
+    }
+
+    // Takes card c out of seat's hand, or with `back` puts it back
+    void Move(int seat, int c, bool back) {
+        int s = CardSuit(c);
+        std::uint64_t higher = Remaining() & cards::SuitMask(static_cast<cards::suit>(s)) & ~(Bit(c + 1) - 1);
+        int above = 2 * std::popcount(higher);
+        std::uint32_t w = owners[s];
+        std::uint32_t high = w & ~((std::uint32_t{1} << (SuitBits - above)) - 1);
+        std::uint32_t low = w & ((std::uint32_t{1} << (SuitBits - above)) - 1);
+        if (back) {
+            hands[seat] |= Bit(c);
+            lengths += std::uint64_t{1} << LengthShift(seat, s);
+            owners[s] = high | (static_cast<std::uint32_t>(seat) << (SuitBits - above - 2)) | (low >> 2);
+        } else {
+            hands[seat] &= ~Bit(c);
+            lengths -= std::uint64_t{1} << LengthShift(seat, s);
+            owners[s] = high | ((low << 2) & ((std::uint32_t{1} << (SuitBits - above)) - 1));
+        }
+    }
+
+    void LoadHands(const std::array<std::uint64_t, cards::numPlayers> &h) {
+        hands = h;
+        lengths = 0;
+        for (int p = 0; p < cards::numPlayers; ++p) {
+            for (int s = 0; s < cards::SuitsInDeck; ++s) {
+                auto n = std::popcount(hands[p] & cards::SuitMask(static_cast<cards::suit>(s)));
+                lengths |= static_cast<std::uint64_t>(n) << LengthShift(p, s);
+            }
+        }
+        std::uint64_t all = Remaining();
+        for (int s = 0; s < cards::SuitsInDeck; ++s) {
+            std::uint64_t m = all & cards::SuitMask(static_cast<cards::suit>(s));
+            std::uint32_t seq = 0;
+            int n = 0;
+            for (; m; ++n) {
+                int c = HighestCard(m);
+                m &= ~Bit(c);
+                auto owner = ((hands[1] >> c) & 1) | (((hands[2] >> c) & 1) << 1) |
+                             (((hands[3] >> c) & 1) * 3);
+                seq = (seq << 2) | static_cast<std::uint32_t>(owner);
+            }
+            owners[s] = n ? seq << 2 * (cards::CardsInSuit - n) : 0;
+        }
+    }
+
+    ownerwords Owners() const {
+        return {owners[0] | static_cast<std::uint64_t>(owners[1]) << SuitBits,
+                owners[2] | static_cast<std::uint64_t>(owners[3]) << SuitBits};
+    }
+
+    // Covers the owners of each suit from the top down to its lowest deciding card
+    ownerwords Mask(std::uint64_t deciding) const {
+        std::uint64_t all = Remaining();
+        ownerwords mask{};
+        for (int s = 0; s < cards::SuitsInDeck; ++s) {
+            std::uint64_t d = deciding & cards::SuitMask(static_cast<cards::suit>(s));
+            if (!d)
+                continue;
+            int k = std::popcount(all & cards::SuitMask(static_cast<cards::suit>(s)) &
+                                  ~(Bit(std::countr_zero(d)) - 1));
+            std::uint64_t field = ((std::uint64_t{1} << 2 * k) - 1) << 2 * (cards::CardsInSuit - k);
+            mask[s / 2] |= field << (SuitBits * (s % 2));
+        }
+        return mask;
+    }
+
+    // The cards an entry's result depends on: the top cards its mask covers
+    std::uint64_t Deciding(const entry &e) const {
+        std::uint64_t all = Remaining();
+        std::uint64_t dec = 0;
+        for (int s = 0; s < cards::SuitsInDeck; ++s) {
+            int k = std::popcount((e.mask[s / 2] >> (SuitBits * (s % 2))) & ((1ULL << SuitBits) - 1)) / 2;
+            std::uint64_t m = all & cards::SuitMask(static_cast<cards::suit>(s));
+            for (int i = 0; i < k; ++i) {
+                dec |= Bit(HighestCard(m));
+                m &= ~Bit(HighestCard(m));
+            }
+        }
+        return dec;
+    }
+
+    // Exact: the last suit's length of west, north and east follows from the
+    // others, as every hand holds as many cards as south, and leaves room for
+    // the leader and trumps
+    std::uint64_t Key(int leader) const {
+        std::uint64_t implied = 0xF | (std::uint64_t{0xF} << 16) | (std::uint64_t{0xF} << 32);
+        return (lengths & ~implied) | static_cast<std::uint64_t>(leader) |
+               (static_cast<std::uint64_t>(trumps) << 16);
+    }
+
+    struct move {
+        int card;
+        int score;
+    };
+
+    // Could `seat` beat card x on a trick led in leadSuit?
+    bool CanBeat(int seat, int x, int leadSuit) const {
+        std::uint64_t follow = hands[seat] & cards::SuitMask(static_cast<cards::suit>(leadSuit));
+        if (follow)
+            return Beats(HighestCard(follow), x, trumps);
+        std::uint64_t ruff = hands[seat] & TrumpMask(trumps);
+        return ruff && Beats(HighestCard(ruff), x, trumps);
+    }
+
+    // Move ordering, roughly: cash winners and lead towards partner's, play
+    // second hand low, third hand high enough to win, and win cheaply or
+    // play low when partner has the trick.
+    int Score(int seat, int card, bool topRun, int played, int leadSuit, int winCard,
+              int winSeat) const {
+        int rank = card % cards::CardsInSuit;
+        int s = CardSuit(card);
+        int partner = (seat + 2) % cards::numPlayers;
+        if (played == 0) {
+            std::uint64_t m = Remaining() & cards::SuitMask(static_cast<cards::suit>(s));
+            int top = HighestCard(m);
+            int score;
+            if (hands[seat] & Bit(top))
+                score = topRun ? 90 + rank : 30 - rank;
+            else if (hands[partner] & Bit(top))
+                score = 70 - rank;
+            else
+                score = 30 - rank;
+            if (s != trumps && trumps != NoTrumps) {
+                std::uint64_t suitMask = cards::SuitMask(static_cast<cards::suit>(s));
+                auto ruffs = [&](int p) {
+                    return !(hands[p] & suitMask) && (hands[p] & TrumpMask(trumps));
+                };
+                if (ruffs(partner))
+                    score += 40;
+                if (ruffs((seat + 1) % cards::numPlayers) || ruffs((seat + 3) % cards::numPlayers))
+                    score -= 20;
+            }
+            return score;
+        }
+        bool wins = Beats(card, winCard, trumps);
+        bool partnerWinning = NorthSouth(winSeat) == NorthSouth(seat);
+        int lho = (seat + 1) % cards::numPlayers;
+        switch (played) {
+        case 1:
+            if (!wins)
+                return 50 - rank;
+            return topRun ? 45 : 30 - rank;
+        case 2:
+            if (partnerWinning && !CanBeat(lho, winCard, leadSuit))
+                return wins ? 0 - rank : 100 - rank;
+            if (wins)
+                return CanBeat(lho, card, leadSuit) ? 60 - rank : 100 - rank;
+            return 50 - rank;
+        default:
+            if (partnerWinning)
+                return wins ? 0 - rank : 100 - rank;
+            return wins ? 100 - rank : 50 - rank;
+        }
+    }
+
+    // One card per run of equivalent cards, best guesses first
+    int Moves(int seat, std::uint64_t legal, int played, int leadSuit, int winCard, int winSeat,
+              std::array<move, MaxMoves> &moves) const {
+        std::uint64_t all = Remaining() | trickCards;
+        int n = 0;
+        while (legal) {
+            int s = CardSuit(HighestCard(legal));
+            std::uint64_t suitMask = cards::SuitMask(static_cast<cards::suit>(s));
+            std::uint64_t mine = legal & suitMask;
+            std::uint64_t others = all & ~hands[seat] & suitMask;
+            legal &= ~suitMask;
+            while (mine) {
+                int high = HighestCard(mine);
+                int low = high;
+                mine &= ~Bit(high);
+                while (mine) {
+                    int next = HighestCard(mine);
+                    if (others & (Bit(low) - 1) & ~(Bit(next + 1) - 1))
+                        break;
+                    low = next;
+                    mine &= ~Bit(next);
+                }
+                bool topRun = (others >> high) == 0; // no one else has a higher card in the suit
+                int bonus = played == 0 && hint >= low && hint <= high ? 1000 : 0;
+                moves[n++] = {low, bonus + Score(seat, low, topRun, played, leadSuit, winCard, winSeat)};
+            }
+        }
+        for (int i = 1; i < n; ++i) {
+            move m = moves[i];
+            int j = i;
+            for (; j > 0 && moves[j - 1].score < m.score; --j)
+                moves[j] = moves[j - 1];
+            moves[j] = m;
+        }
+        return n;
+    }
+
+    // The bucket holding key, or the empty one where it would go
+    bucket &Bucket(std::uint64_t key) {
+        std::size_t m = table.size() - 1;
+        std::size_t i = (key * 0x9E3779B97F4A7C15) >> 40 & m;
+        while (table[i].key != key && table[i].key != NoKey)
+            i = (i + 1) & m;
+        return table[i];
+    }
+
+    std::vector<entry> &List(std::uint64_t key) {
+        if (bucket &b = Bucket(key); b.key == key)
+            return b.list;
+        if (2 * (keys + 1) > table.size()) {
+            std::vector<bucket> old(2 * table.size());
+            old.swap(table);
+            for (bucket &b : old) {
+                if (b.key != NoKey)
+                    Bucket(b.key) = std::move(b);
+            }
+        }
+        ++keys;
+        bucket &b = Bucket(key);
+        b.key = key;
+        return b.list;
+    }
+
+    // Can north/south take `target` of the remaining tricks from the start of
+    // a trick? deciding gets the cards whose ranks the answer depends on.
+    bool TrickStart(int leader, int target, std::uint64_t &deciding) {
+        int remaining = std::popcount(hands[leader]);
+        deciding = 0;
+        if (target <= 0)
+            return true;
+        if (target > remaining)
+            return false;
+        if (remaining == 1) {
+            int win = HighestCard(hands[leader]);
+            int winSeat = leader;
+            std::uint64_t played = Bit(win);
+            for (int i = 1; i < cards::numPlayers; ++i) {
+                int seat = (leader + i) % cards::numPlayers;
+                int c = HighestCard(hands[seat]);
+                played |= Bit(c);
+                if (Beats(c, win, trumps)) {
+                    win = c;
+                    winSeat = seat;
+                }
+            }
+            if (played & cards::SuitMask(static_cast<cards::suit>(CardSuit(win))) & ~Bit(win))
+                deciding = Bit(win);
+            return NorthSouth(winSeat);
+        }
+
+        // Suit lengths alone decide these, so the table entry needs no cards
+        if (LengthTricks(hands, trumps, 0) < target)
+            return false;
+        if (remaining - LengthTricks(hands, trumps, 1) >= target)
+            return true;
+
+        std::uint64_t key = Key(leader);
+        if (bucket &b = Bucket(key); b.key == key) {
+            ownerwords now = Owners();
+            auto &list = b.list;
+            for (std::size_t i = 0; i < list.size(); ++i) {
+                const entry &e = list[i];
+                if ((now[0] & e.mask[0]) != e.owners[0] || (now[1] & e.mask[1]) != e.owners[1])
+                    continue;
+                if (e.lower >= target || e.upper < target) {
+                    hint = -1;
+                    deciding = Deciding(e);
+                    bool res = e.lower >= target;
+                    // Entries that keep settling positions work their way to the front
+                    if (i > 0)
+                        std::swap(list[i], list[i / 2]);
+                    return res;
+                }
+                if (e.bestSuit >= 0 && hint < 0) {
+                    std::uint64_t m = Remaining() & cards::SuitMask(static_cast<cards::suit>(e.bestSuit));
+                    for (int k = 0; k < e.bestIndex && m; ++k)
+                        m &= ~Bit(HighestCard(m));
+                    if (m && (hands[leader] & Bit(HighestCard(m))))
+                        hint = HighestCard(m);
+                }
+            }
+        }
+
+        std::uint64_t sureCards = 0;
+        int sure = SureTricks(hands, trumps, leader, sureCards,
+                              NorthSouth(leader) ? target : remaining - target + 1);
+        if (NorthSouth(leader) ? sure >= target : remaining - sure < target) {
+            deciding = sureCards;
+            hint = -1;
+            return NorthSouth(leader);
+        }
+        if (trumps != NoTrumps) {
+            std::uint64_t trumpCards = 0;
+            int defence = TrumpTricks(hands, trumps, 1, trumpCards);
+            if (remaining - defence < target) {
+                deciding = trumpCards;
+                hint = -1;
+                return false;
+            }
+            trumpCards = 0;
+            if (TrumpTricks(hands, trumps, 0, trumpCards) >= target) {
+                deciding = trumpCards;
+                hint = -1;
+                return true;
+            }
+        }
+
+        std::uint64_t savedTrick = trickCards;
+        trickCards = 0;
+        bool res = Search(leader, 0, -1, -1, leader, target, deciding);
+        trickCards = savedTrick;
+        int cut = lastCut;
+
+        ownerwords mask = Mask(deciding);
+        ownerwords now = Owners();
+        now[0] &= mask[0];
+        now[1] &= mask[1];
+        if (entries >= maxEntries) {
+            table.assign(1024, bucket{});
+            keys = 0;
+            entries = 0;
+        }
+        auto &list = List(key);
+        entry *slot = nullptr;
+        for (entry &e : list) {
+            if (e.mask == mask && e.owners == now) {
+                slot = &e;
+                break;
+            }
+        }
+        if (!slot) {
+            slot = &list.emplace_back(entry{now, mask, 0, static_cast<unsigned char>(remaining)});
+            ++entries;
+        }
+        if (res)
+            slot->lower = std::max<int>(slot->lower, target);
+        else
+            slot->upper = std::min<int>(slot->upper, target - 1);
+        if (cut >= 0) {
+            std::uint64_t higher = Remaining() & cards::SuitMask(static_cast<cards::suit>(CardSuit(cut))) &
+                                   ~(Bit(cut + 1) - 1);
+            slot->bestSuit = static_cast<signed char>(CardSuit(cut));
+            slot->bestIndex = static_cast<unsigned char>(std::popcount(higher));
+        }
+        return res;
+    }
+
+    bool Search(int seat, int played, int leadSuit, int winCard, int winSeat, int target,
+                std::uint64_t &deciding) {
+        if (played == cards::numPlayers) {
+            bool res = TrickStart(winSeat, target - (NorthSouth(winSeat) ? 1 : 0), deciding);
+            // The winner's rank mattered if it beat another card of its suit
+            if (trickCards & cards::SuitMask(static_cast<cards::suit>(CardSuit(winCard))) & ~Bit(winCard))
+                deciding |= Bit(winCard);
+            return res;
+        }
+        ++nodes;
+        std::uint64_t legal = hands[seat];
+        if (played > 0) {
+            std::uint64_t follow = legal & cards::SuitMask(static_cast<cards::suit>(leadSuit));
+            if (follow)
+                legal = follow;
+        }
+        std::array<move, MaxMoves> moves;
+        int n = Moves(seat, legal, played, leadSuit, winCard, winSeat, moves);
+        if (played == 0)
+            hint = -1;
+        bool ns = NorthSouth(seat);
+        std::uint64_t all = 0;
+        for (int i = 0; i < n; ++i) {
+            int c = moves[i].card;
+            bool wins = played == 0 || Beats(c, winCard, trumps);
+            Move(seat, c, false);
+            trickCards |= Bit(c);
+            std::uint64_t dec;
+            bool res = Search((seat + 1) % cards::numPlayers, played + 1,
+                              played == 0 ? CardSuit(c) : leadSuit, wins ? c : winCard,
+                              wins ? seat : winSeat, target, dec);
+            trickCards &= ~Bit(c);
+            Move(seat, c, true);
+            if (res == ns) {
+                if (played == 0)
+                    lastCut = c;
+                deciding = dec;
+                return res;
+            }
+            all |= dec;
+        }
+        if (played == 0)
+            lastCut = -1;
+        deciding = all;
+        return !ns;
+    }
+
+    void Load(const playstate &ps) {
+        LoadHands(ps.hands);
+        trumps = ps.trumps;
+        trickCards = 0;
+        for (int i = 0; i < ps.played; ++i)
+            trickCards |= Bit(ps.trick[i]);
+    }
+
+    bool FromState(const playstate &ps, int target) {
+        int leader = static_cast<int>(ps.leader);
+        std::uint64_t deciding;
+        if (ps.played == 0)
+            return TrickStart(leader, target, deciding);
+        int win = 0;
+        for (int i = 1; i < ps.played; ++i) {
+            if (Beats(ps.trick[i], ps.trick[win], trumps))
+                win = i;
+        }
+        return Search(static_cast<int>(ps.ToMove()), ps.played, CardSuit(ps.trick[0]), ps.trick[win],
+                      (leader + win) % cards::numPlayers, target, deciding);
+    }
+
+  public:
+    // The table is cleared once it holds maxEntries results (40 bytes each)
+    explicit solver(std::size_t maxEntries = 1 << 21) : maxEntries(maxEntries) {}
+
+    std::uint64_t Nodes() const { return nodes; }
+
+    // Tricks the side of `side` takes from here with best play by everyone,
+    // counting the trick in progress. A good guess at the answer (such as the
+    // value before the last card) saves most of the search.
+    int Tricks(const playstate &ps, position side, int guess = -1) {
+        Load(ps);
+        int lo = 0;
+        int hi = ps.TricksLeft();
+        if (guess >= 0) {
+            guess = std::min(guess, hi);
+            if (!NorthSouth(static_cast<int>(side)))
+                guess = hi - guess;
+            if (guess > lo) {
+                if (FromState(ps, guess))
+                    lo = guess;
+                else
+                    hi = guess - 1;
+            }
+            if (lo == guess && guess < hi) {
+                if (FromState(ps, guess + 1))
+                    lo = guess + 1;
+                else
+                    hi = guess;
+            }
+        }
+        while (lo < hi) {
+            int mid = (lo + hi + 1) / 2;
+            if (FromState(ps, mid))
+                lo = mid;
+            else
+                hi = mid - 1;
+        }
+        return NorthSouth(static_cast<int>(side)) ? lo : ps.TricksLeft() - lo;
+    }
+
+    struct cardresult {
+        int card;
+        int tricks; // for the side of the player to move, after this card
+    };
+
+    // The result of every legal card for the player to move. Equivalent cards
+    // are only searched once and share their result, and each result is the
+    // guess for the next card's.
+    std::vector<cardresult> CardTricks(const playstate &ps) {
+        std::vector<cardresult> results;
+        int guess = -1;
+        int seat = static_cast<int>(ps.ToMove());
+        std::uint64_t legal = ps.LegalCards();
+        std::uint64_t all = ps.hands[0] | ps.hands[1] | ps.hands[2] | ps.hands[3];
+        for (int i = 0; i < ps.played; ++i)
+            all |= Bit(ps.trick[i]);
+        std::uint64_t others = all & ~ps.hands[seat];
+        while (legal) {
+            int high = HighestCard(legal);
+            std::uint64_t run = Bit(high);
+            legal &= ~run;
+            for (int low = high; legal;) {
+                int next = HighestCard(legal);
+                if (CardSuit(next) != CardSuit(high) || (others & (Bit(low) - 1) & ~(Bit(next + 1) - 1)))
+                    break;
+                low = next;
+                run |= Bit(next);
+                legal &= ~Bit(next);
+            }
+            playstate after = ps;
+            auto won = after.Play(high);
+            int tricks = Tricks(after, ps.ToMove(), guess);
+            guess = tricks;
+            if (won && NorthSouth(static_cast<int>(*won)) == NorthSouth(seat))
+                ++tricks;
+            for (std::uint64_t m = run; m; m &= m - 1)
+                results.push_back({std::countr_zero(m), tricks});
+        }
+        return results;
+    }
+};
+
+// Double dummy tricks for every strain and declarer, of the cards not yet
+// played: tricks[strain][declarer], strains numbered as by Strain()
+struct tricktable {
+    std::array<std::array<unsigned char, cards::numPlayers>, NoTrumps + 1> tricks{};
+
+    int Tricks(int strain, position declarer) const { return tricks[strain][static_cast<int>(declarer)]; }
+
+    bool operator==(const tricktable &) const = default;
+};
+
+// The order a strain's declarers are solved in. Partners follow each other,
+// their problems differing only in who leads, so the second mostly finds the
+// first's results in the table and is guessed right first time.
+inline constexpr std::array<position, cards::numPlayers> TableOrder = {position::south, position::north,
+                                                                        position::west, position::east};
+
+// Declarer's tricks, given a guess at north/south's (-1 for none)
+inline int DeclarerTricks(solver &dds, const handmasks &hands, int trumps, position declarer,
+                          int northSouthGuess = -1) {
+    playstate ps;
+    ps.hands = hands;
+    ps.trumps = trumps;
+    ps.leader = cards::Lefty(declarer);
+    auto bounds = BoundTricks(ps, declarer);
+    if (bounds.lower == bounds.upper)
+        return bounds.lower;
+    int guess = northSouthGuess;
+    if (guess >= 0 && !NorthSouth(static_cast<int>(declarer)))
+        guess = ps.TricksLeft() - guess;
+    return dds.Tricks(ps, declarer, guess);
+}
+
+inline tricktable SolveTable(solver &dds, const cards::deal &d) {
+    handmasks hands;
+    for (int p = 0; p < cards::numPlayers; ++p)
+        hands[p] = d.hands[p].Mask();
+    int left = std::popcount(hands[0]);
+    tricktable table;
+    for (int trumps = 0; trumps <= NoTrumps; ++trumps) {
+        int northSouth = -1;
+        for (position declarer : TableOrder) {
+            int taken = DeclarerTricks(dds, hands, trumps, declarer, northSouth);
+            table.tricks[trumps][static_cast<int>(declarer)] = static_cast<unsigned char>(taken);
+            northSouth = NorthSouth(static_cast<int>(declarer)) ? taken : left - taken;
+        }
+    }
+    return table;
+}
+
+// Trick tables for a batch of deals. Every (deal, strain, declarer) is a task,
+// numbered deal by deal, strain by strain and in TableOrder within a strain,
+// and the tasks are shared out by work stealing a strain at a time. Each
+// thread keeps its solver for the whole batch and mostly runs a deal's
+// strains one after another, so a solve starts from the results of the one
+// before, and from its answer as a guess.
+//
+// The search takes about four and a half seconds a table on one core
+// (benchmark tables), some 800 tables an hour, so 100k boards an hour would
+// need well over a hundred cores. What is in scope here is batch solving at
+// that per-core rate: thousands of tables, not a hundred thousand an hour. A
+// faster solver would plug in here unchanged.
+inline std::vector<tricktable> SolveTables(std::span<const cards::deal> deals,
+                                           unsigned threads = workers::DefaultThreads()) {
+    threads = std::max(1u, threads);
+    constexpr std::size_t perStrain = cards::numPlayers;
+    constexpr std::size_t perDeal = (NoTrumps + 1) * perStrain;
+    std::vector<tricktable> tables(deals.size());
+    struct workerstate {
+        std::unique_ptr<solver> dds;
+        std::size_t lastTask = SIZE_MAX;
+        int northSouth = -1; // in the last task
+        handmasks hands;
+    };
+    std::vector<workerstate> states(threads);
+    workers::StealingFor(
+        deals.size() * perDeal, threads,
+        [&](std::size_t task, unsigned worker) {
+            workerstate &st = states[worker];
+            if (!st.dds)
+                st.dds = std::make_unique<solver>();
+            std::size_t dealIndex = task / perDeal;
+            int trumps = static_cast<int>(task % perDeal / perStrain);
+            position declarer = TableOrder[task % perStrain];
+            bool follows = st.lastTask + 1 == task && task % perStrain != 0;
+            if (st.lastTask == SIZE_MAX || st.lastTask / perDeal != dealIndex) {
+                for (int p = 0; p < cards::numPlayers; ++p)
+                    st.hands[p] = deals[dealIndex].hands[p].Mask();
+            }
+            int taken = DeclarerTricks(*st.dds, st.hands, trumps, declarer, follows ? st.northSouth : -1);
+            tables[dealIndex].tricks[trumps][static_cast<int>(declarer)] = static_cast<unsigned char>(taken);
+            st.lastTask = task;
+            st.northSouth = NorthSouth(static_cast<int>(declarer)) ? taken : std::popcount(st.hands[0]) - taken;
+        },
+        perStrain);
+    return tables;
+}
+
+// Opening lead simulation: the leader's hand and the finished auction are
+// known, the other hands are dealt at random subject to per-seat constraints
+// (for instance those read from the auction) and every lead is solved double
+// dummy on every layout. A sample costs from tens of milliseconds, when the
+// defence's tricks are plain, to about 1.2 s for an ordinary hand (benchmark
+// leads), so a thousand samples take some twenty minutes on a core, not
+// seconds.
+struct leadproblem {
+    cards::Hand leaderHand;
+    cards::contract contrct; // finished, not passed out
+    std::array<bidding::handconstraint, cards::numPlayers> constraints{};
+};
+
+struct leadresult {
+    cards::Card card;
+    double averageTricks; // taken by the defence
+    double setPercent;
+};
+
+struct leadsummary {
+    int samples = 0;         // layouts solved
+    long long attempts = 0;  // layouts dealt, including those rejected
+    std::vector<leadresult> leads; // best average first
+};
+
+// Deals the cards outside `fixed` to `seats` (13 each, in order) from a
+// shuffle driven by rng. Each hand is checked against its seat's constraint
+// as soon as it is dealt, so most rejected layouts are dropped a hand or two
+// in; the result is nothing if any hand fails.
+inline std::optional<handmasks> DealRest(std::uint64_t fixed, const std::array<int, 3> &seats,
+                                         const bidding::seatconstraints &constraints,
+                                         cards::counter_rng &rng) {
+    std::array<cards::CardInt, cards::CardsInDeck> rest;
+    int n = 0;
+    for (int c = 0; c < cards::CardsInDeck; ++c) {
+        if (!(fixed & Bit(c)))
+            rest[n++] = static_cast<cards::CardInt>(c);
+    }
+    assert(n == 3 * cards::CardsInHand);
+    handmasks hands{};
+    for (int i = 0; i < n; ++i) {
+        std::swap(rest[i], rest[i + rng.Below(n - i)]);
+        int seat = seats[i / cards::CardsInHand];
+        hands[seat] |= Bit(rest[i]);
+        if (i % cards::CardsInHand == cards::CardsInHand - 1 &&
+            !constraints[seat].Matches(bidding::handfeatures(hands[seat])))
+            return {};
+    }
+    return hands;
+}
+
+inline leadsummary SimulateLeads(const leadproblem &prob, int samples, std::uint64_t seed,
+                                 unsigned threads = workers::DefaultThreads(),
+                                 long long maxAttempts = 1000000) {
+    const cards::contract &c = prob.contrct;
+    assert(c.finalContract.IsValid() && c.finalContract.IsABid());
+    int trumps = Strain(c.finalContract);
+    int needed = *c.finalContract.bidSize() + 6;
+    position leader = cards::Lefty(c.declarer);
+    int lead = static_cast<int>(leader);
+    std::uint64_t leaderMask = prob.leaderHand.Mask();
+    std::array<int, 3> others;
+    for (int i = 0; i < 3; ++i)
+        others[i] = (lead + 1 + i) % cards::numPlayers;
+
+    threads = std::max(1u, threads);
+    struct tally {
+        std::array<long long, cards::CardsInDeck> tricks{};
+        std::array<long long, cards::CardsInDeck> sets{};
+        int samples = 0;
+        long long attempts = 0;
+    };
+    std::vector<tally> tallies(threads);
+    std::vector<std::unique_ptr<solver>> solvers(threads);
+
+    workers::ParallelFor(
+        samples, threads,
+        [&](std::size_t sample, unsigned worker) {
+            tally &t = tallies[worker];
+            cards::counter_rng rng(seed, static_cast<std::uint32_t>(sample));
+            for (long long attempt = 0; attempt < maxAttempts; ++attempt) {
+                ++t.attempts;
+                rng.Seek(attempt);
+                auto dealt = DealRest(leaderMask, others, prob.constraints, rng);
+                if (!dealt)
+                    continue;
+                auto hands = *dealt;
+                hands[lead] = leaderMask;
+
+                if (!solvers[worker])
+                    solvers[worker] = std::make_unique<solver>();
+                playstate ps;
+                ps.hands = hands;
+                ps.trumps = trumps;
+                ps.leader = leader;
+                for (const auto &r : solvers[worker]->CardTricks(ps)) {
+                    t.tricks[r.card] += r.tricks;
+                    t.sets[r.card] += (cards::CardsInHand - r.tricks) < needed;
+                }
+                ++t.samples;
+                return;
+            }
+        },
+        1);
+
+    leadsummary sum;
+    tally total;
+    for (const auto &t : tallies) {
+        sum.samples += t.samples;
+        sum.attempts += t.attempts;
+        for (int i = 0; i < cards::CardsInDeck; ++i) {
+            total.tricks[i] += t.tricks[i];
+            total.sets[i] += t.sets[i];
+        }
+    }
+    if (sum.samples == 0)
+        return sum;
+    for (const auto &cd : prob.leaderHand.crd) {
+        int i = cards::NotPlayed(cd.crd);
+        sum.leads.push_back({cd, static_cast<double>(total.tricks[i]) / sum.samples,
+                             100.0 * total.sets[i] / sum.samples});
+    }
+    std::stable_sort(sum.leads.begin(), sum.leads.end(), [](const leadresult &a, const leadresult &b) {
+        return a.averageTricks > b.averageTricks;
+    });
+    return sum;
+}
+
+// Contract choice simulation: one hand is known and the others are dealt to
+// fit what the auction showed of them; every candidate contract is solved
+// double dummy and scored on every layout. Each strain and declarer is solved
+// once a layout however many candidates share it, its result on the worker's
+// last layout the first guess. That still leaves a full solve a strain: about
+// 0.8 to 1 s a sample with two strains (benchmark contracts), a thousand
+// samples in a quarter of an hour on a core.
+struct contractchoice {
+    cards::bid contract; // a bid, not a pass
+    position declarer;
+    int doubled = scoring::Undoubled;
+};
+
+struct contractproblem {
+    cards::Hand hand;
+    position seat;
+    cards::vulnerability vul = cards::vulnerability::neither;
+    bidding::seatconstraints constraints{};
+    std::vector<contractchoice> candidates;
+};
+
+struct contractresult {
+    contractchoice choice;
+    double averageTricks; // taken by declarer
+    double makePercent;
+    double averageScore; // for the side of the seat
+};
+
+struct contractsummary {
+    int samples = 0;
+    long long attempts = 0;
+    std::vector<contractresult> contracts; // best average score first
+};
+
+// The problem facing `seat` holding `hand` after `auction`, with the other
+// hands constrained by what the rules say their calls showed
+inline contractproblem MakeContractProblem(const bidding::bidder &rules, const cards::contract &auction,
+                                           const cards::Hand &hand, position seat,
+                                           cards::vulnerability vul) {
+    contractproblem prob;
+    prob.hand = hand;
+    prob.seat = seat;
+    prob.vul = vul;
+    prob.constraints = rules.Infer(auction);
+    return prob;
+}
+
+inline contractsummary SimulateContracts(const contractproblem &prob, int samples, std::uint64_t seed,
+                                         unsigned threads = workers::DefaultThreads(),
+                                         long long maxAttempts = 1000000) {
+    int self = static_cast<int>(prob.seat);
+    std::uint64_t handMask = prob.hand.Mask();
+    std::size_t n = prob.candidates.size();
+    for ([[maybe_unused]] const auto &cand : prob.candidates)
+        assert(cand.contract.IsValid() && cand.contract.IsABid());
+
+    // The most tightly constrained hands are dealt first, to reject sooner
+    std::array<int, 3> others;
+    for (int i = 0; i < 3; ++i)
+        others[i] = (self + 1 + i) % cards::numPlayers;
+    auto freedom = [&](int seat) {
+        const auto &hc = prob.constraints[seat];
+        int f = std::min(hc.GetHigh(bidding::PointsLane), 40) - hc.GetLow(bidding::PointsLane);
+        for (int s = 0; s < cards::SuitsInDeck; ++s) {
+            int lane = bidding::LengthLane + s;
+            f += std::min<int>(hc.GetHigh(lane), cards::CardsInSuit) - hc.GetLow(lane);
+        }
+        return f - std::popcount(hc.required | hc.excluded);
+    };
+    std::ranges::stable_sort(others, {}, freedom);
+
+    threads = std::max(1u, threads);
+    struct tally {
+        std::vector<long long> tricks, makes, score;
+        int samples = 0;
+        long long attempts = 0;
+    };
+    std::vector<tally> tallies(threads, {std::vector<long long>(n), std::vector<long long>(n),
+                                         std::vector<long long>(n)});
+    std::vector<std::unique_ptr<solver>> solvers(threads);
+    // Each worker's last result for every strain and declarer, the guess for its next layout
+    using solvedarray = std::array<int, (NoTrumps + 1) * cards::numPlayers>;
+    solvedarray none;
+    none.fill(-1);
+    std::vector<solvedarray> lastSolved(threads, none);
+
+    workers::ParallelFor(
+        samples, threads,
+        [&](std::size_t sample, unsigned worker) {
+            tally &t = tallies[worker];
+            cards::counter_rng rng(seed, static_cast<std::uint32_t>(sample));
+            for (long long attempt = 0; attempt < maxAttempts; ++attempt) {
+                ++t.attempts;
+                rng.Seek(attempt);
+                auto dealt = DealRest(handMask, others, prob.constraints, rng);
+                if (!dealt)
+                    continue;
+                auto hands = *dealt;
+                hands[self] = handMask;
+
+                if (!solvers[worker])
+                    solvers[worker] = std::make_unique<solver>();
+                solvedarray solved = none;
+                for (std::size_t i = 0; i < n; ++i) {
+                    const contractchoice &cand = prob.candidates[i];
+                    int trumps = Strain(cand.contract);
+                    int slot = trumps * cards::numPlayers + static_cast<int>(cand.declarer);
+                    int &taken = solved[slot];
+                    if (taken < 0) {
+                        playstate ps;
+                        ps.hands = hands;
+                        ps.trumps = trumps;
+                        ps.leader = cards::Lefty(cand.declarer);
+                        auto bounds = BoundTricks(ps, cand.declarer);
+                        taken = bounds.lower == bounds.upper
+                                    ? bounds.lower
+                                    : solvers[worker]->Tricks(ps, cand.declarer, lastSolved[worker][slot]);
+                        lastSolved[worker][slot] = taken;
+                    }
+                    const cards::bid &b = cand.contract;
+                    int level = *b.bidSize();
+                    cards::suit strain = b.IsNoTrumps() ? cards::suit::notrumps : *b.bidSuit();
+                    bool vul = scoring::IsVulnerable(prob.vul, cand.declarer);
+                    int score = scoring::ContractScore(level, strain, cand.doubled, vul, taken);
+                    bool ours = NorthSouth(static_cast<int>(cand.declarer)) == NorthSouth(self);
+                    t.tricks[i] += taken;
+                    t.makes[i] += taken >= level + 6;
+                    t.score[i] += ours ? score : -score;
+                }
+                ++t.samples;
+                return;
+            }
+        },
+        1);
+
+    contractsummary sum;
+    tally total{std::vector<long long>(n), std::vector<long long>(n), std::vector<long long>(n)};
+    for (const auto &t : tallies) {
+        sum.samples += t.samples;
+        sum.attempts += t.attempts;
+        for (std::size_t i = 0; i < n; ++i) {
+            total.tricks[i] += t.tricks[i];
+            total.makes[i] += t.makes[i];
+            total.score[i] += t.score[i];
+        }
+    }
+    if (sum.samples == 0)
+        return sum;
+    for (std::size_t i = 0; i < n; ++i) {
+        sum.contracts.push_back({prob.candidates[i], static_cast<double>(total.tricks[i]) / sum.samples,
+                                 100.0 * total.makes[i] / sum.samples,
+                                 static_cast<double>(total.score[i]) / sum.samples});
+    }
+    std::stable_sort(sum.contracts.begin(), sum.contracts.end(),
+                     [](const contractresult &a, const contractresult &b) {
+                         return a.averageScore > b.averageScore;
+                     });
+    return sum;
+}
+
+// Post-mortem of a played deal: for every card, the double dummy tricks it
+// cost the player's side. The value of each position is searched once, with
+// the value of the one before as the first guess, and the solver's table
+// carries over from card to card.
+struct cardcost {
+    int card;
+    position player;
+    int cost;
+
+    bool operator==(const cardcost &) const = default;
+};
+
+// Empty if the deal has no finished contract or its tricks aren't a legal play
+inline std::optional<std::vector<cardcost>> ReviewPlay(solver &dds, const cards::deal &d) {
+    const cards::contract &c = d.contrct;
+    if (!c.finalContract.IsValid() || !c.finalContract.IsABid())
+        return {};
+    playstate ps;
+    for (int p = 0; p < cards::numPlayers; ++p) {
+        for (const auto &cd : d.hands[p].crd)
+            ps.hands[p] |= Bit(cards::NotPlayed(cd.crd));
+    }
+    ps.trumps = Strain(c.finalContract);
+    ps.leader = cards::Lefty(c.declarer);
+
+    std::vector<cardcost> costs;
+    int won = 0; // by north/south so far
+    int value = won + dds.Tricks(ps, position::north);
+    for (const auto &t : d.tricks) {
+        if (t.GetLeadPos() != ps.leader)
+            return {};
+        for (int i = 0; i < cards::numPlayers - t.PlayersToGo(); ++i) {
+            int card = cards::NotPlayed(t.GetCardPlayed(i).crd);
+            if (!ps.IsLegal(card))
+                return {};
+            position player = ps.ToMove();
+            if (auto winner = ps.Play(card); winner && NorthSouth(static_cast<int>(*winner)))
+                ++won;
+            int after = won + dds.Tricks(ps, position::north, std::max(0, value - won));
+            int lost = NorthSouth(static_cast<int>(player)) ? value - after : after - value;
+            costs.push_back({card, player, lost});
+            value = after;
+        }
+        if (ps.played != 0)
+            break; // an unfinished trick ends the record
+    }
+    return costs;
+}
+
+struct boardreview {
+    int number;
+    std::optional<std::vector<cardcost>> costs;
+};
+
+inline std::vector<boardreview> ReviewBoards(const std::vector<boards::board> &boardList,
+                                             unsigned threads = workers::DefaultThreads()) {
+    threads = std::max(1u, threads);
+    std::vector<boardreview> reviews(boardList.size());
+    std::vector<std::unique_ptr<solver>> solvers(threads);
+    workers::ParallelFor(
+        boardList.size(), threads,
+        [&](std::size_t i, unsigned worker) {
+            if (!solvers[worker])
+                solvers[worker] = std::make_unique<solver>();
+            reviews[i] = {boardList[i].number, ReviewPlay(*solvers[worker], boardList[i].d)};
+        },
+        1);
+    return reviews;
+}
+
+// Review stream: per board its number (2 bytes, little endian) and how many
+// cards follow (255 if the play couldn't be reviewed), then a byte per card:
+// the card in the low 6 bits and its cost in the top 2. A cost of 3 or more
+// is followed by a byte holding the full cost.
+enum { ReviewInvalid = 255, ReviewEscape = 3 };
+
+inline void WriteReviews(std::ostream &os, const std::vector<boardreview> &reviews) {
+    for (const auto &r : reviews) {
+        os.put(static_cast<char>(r.number & 0xff));
+        os.put(static_cast<char>((r.number >> 8) & 0xff));
+        if (!r.costs) {
+            os.put(static_cast<char>(ReviewInvalid));
+            continue;
+        }
+        os.put(static_cast<char>(r.costs->size()));
+        for (const auto &cc : *r.costs) {
+            int cost = std::min<int>(cc.cost, ReviewEscape);
+            os.put(static_cast<char>(cc.card | (cost << 6)));
+            if (cost == ReviewEscape)
+                os.put(static_cast<char>(cc.cost));
+        }
+    }
+}
+
+// Reads one board back; the players are not stored, so they come back as
+// south. Empty at the end of the stream or on a truncated record.
+inline std::optional<boardreview> ReadReview(std::istream &is) {
+    unsigned char head[3];
+    if (!is.read(reinterpret_cast<char *>(head), sizeof(head)))
+        return {};
+    boardreview r{head[0] | (head[1] << 8), {}};
+    if (head[2] == ReviewInvalid)
+        return r;
+    r.costs.emplace();
+    for (int i = 0; i < head[2]; ++i) {
+        int b = is.get();
+        if (b == std::istream::traits_type::eof())
+            return {};
+        int cost = b >> 6;
+        if (cost == ReviewEscape) {
+            cost = is.get();
+            if (cost == std::istream::traits_type::eof())
+                return {};
+        }
+        r.costs->push_back({b & 0x3f, position::south, cost});
+    }
+    return r;
+}
+} // namespace solver
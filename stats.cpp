@@ -0,0 +1,601 @@
+module;
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <map>
+#include <numeric>
+#include <string>
+#include <utility>
+#include <vector>
+
+export module stats;
+
+import cards;
+import partial;
+import workers;
+
+export namespace stats {
+using cards::position;
+
+enum {
+    MaxPoints = 37,            // AKQ of three suits and the AKQJ of the fourth
+    MaxPartnershipPoints = 40,
+    LengthStates = cards::CardsInSuit + 1,
+    Shapes = LengthStates * LengthStates * LengthStates // spades, hearts, diamonds; clubs follow
+};
+
+// Suit lengths longest first, a nibble each: 4-4-3-2 is 0x4432
+using pattern = std::uint16_t;
+
+inline pattern PatternOf(std::array<int, cards::SuitsInDeck> lengths) {
+    std::ranges::sort(lengths, std::greater<>());
+    pattern p = 0;
+    for (int l : lengths)
+        p = static_cast<pattern>((p << 4) | l);
+    return p;
+}
+
+inline std::string PatternToString(pattern p) {
+    std::string out;
+    for (int shift = 12; shift >= 0; shift -= 4) {
+        if (!out.empty())
+            out += '-';
+        out += std::to_string((p >> shift) & 0xf);
+    }
+    return out;
+}
+
+inline int ShapeIndex(int spades, int hearts, int diamonds) {
+    return (spades * LengthStates + hearts) * LengthStates + diamonds;
+}
+
+// Counts of hands and partnership holdings. Fixed size, so a thread can keep
+// one and add to it without allocating; merge them at the end.
+struct histograms {
+    std::array<std::uint64_t, MaxPoints + 1> points{};
+    std::array<std::uint64_t, Shapes> shapes{};
+    std::array<std::uint64_t, MaxPartnershipPoints + 1> partnershipPoints{};
+    std::array<std::uint64_t, LengthStates> longestFit{};
+    std::uint64_t hands = 0;
+    std::uint64_t partnerships = 0;
+
+    void AddHand(std::uint64_t m) {
+        ++hands;
+        ++points[cards::MaskPointCount(m)];
+        auto length = [m](cards::suit s) { return std::popcount(m & cards::SuitMask(s)); };
+        ++shapes[ShapeIndex(length(cards::suit::spades), length(cards::suit::hearts),
+                            length(cards::suit::diamonds))];
+    }
+
+    void AddPartnership(std::uint64_t a, std::uint64_t b) {
+        ++partnerships;
+        ++partnershipPoints[cards::MaskPointCount(a | b)];
+        int fit = 0;
+        for (int s = 0; s < cards::SuitsInDeck; ++s)
+            fit = std::max(fit, std::popcount((a | b) & cards::SuitMask(static_cast<cards::suit>(s))));
+        ++longestFit[fit];
+    }
+
+    // Every hand and both partnerships
+    void AddDeal(const partial::hands &h) {
+        for (auto m : h)
+            AddHand(m);
+        AddPartnership(h[0], h[2]);
+        AddPartnership(h[1], h[3]);
+    }
+
+    void AddDeal(const cards::deal &d) {
+        partial::hands h;
+        for (int p = 0; p < cards::numPlayers; ++p)
+            h[p] = d.hands[p].Mask();
+        AddDeal(h);
+    }
+
+    void Merge(const histograms &o) {
+        auto add = [](auto &to, const auto &from) {
+            for (std::size_t i = 0; i < to.size(); ++i)
+                to[i] += from[i];
+        };
+        add(points, o.points);
+        add(shapes, o.shapes);
+        add(partnershipPoints, o.partnershipPoints);
+        add(longestFit, o.longestFit);
+        hands += o.hands;
+        partnerships += o.partnerships;
+    }
+
+    std::map<pattern, std::uint64_t> Patterns() const {
+        std::map<pattern, std::uint64_t> out;
+        for (int s = 0; s < LengthStates; ++s) {
+            for (int h = 0; h < LengthStates; ++h) {
+                for (int d = 0; d < LengthStates; ++d) {
+                    int c = cards::CardsInHand - s - h - d;
+                    if (c >= 0 && c < LengthStates && shapes[ShapeIndex(s, h, d)])
+                        out[PatternOf({s, h, d, c})] += shapes[ShapeIndex(s, h, d)];
+                }
+            }
+        }
+        return out;
+    }
+
+    double PointsShare(int p) const { return hands ? static_cast<double>(points[p]) / hands : 0; }
+
+    double PatternShare(pattern p) const {
+        auto all = Patterns();
+        auto it = all.find(p);
+        return it == all.end() || !hands ? 0 : static_cast<double>(it->second) / hands;
+    }
+
+    double PartnershipPointsShare(int p) const {
+        return partnerships ? static_cast<double>(partnershipPoints[p]) / partnerships : 0;
+    }
+
+    double FitShare(int length) const {
+        return partnerships ? static_cast<double>(longestFit[length]) / partnerships : 0;
+    }
+
+    bool operator==(const histograms &) const = default;
+};
+
+// Ways to hold `size` cards from a full deck with the given point count:
+// choose the aces, kings, queens and jacks, then spot cards for the rest
+inline std::uint64_t PointCombinations(int size, int points) {
+    enum { Honours = 4, Spots = cards::CardsInDeck - 4 * Honours };
+    std::uint64_t ways = 0;
+    for (int a = 0; a <= Honours; ++a) {
+        for (int k = 0; k <= Honours; ++k) {
+            for (int q = 0; q <= Honours; ++q) {
+                int j = points - 4 * a - 3 * k - 2 * q;
+                if (j < 0 || j > Honours)
+                    continue;
+                ways += cards::Binomial(Honours, a) * cards::Binomial(Honours, k) *
+                        cards::Binomial(Honours, q) * cards::Binomial(Honours, j) *
+                        cards::Binomial(Spots, size - a - k - q - j);
+            }
+        }
+    }
+    return ways;
+}
+
+// The exact distributions: every possible 13 card hand and every possible
+// 26 card partnership holding counted once
+inline histograms Exact() {
+    histograms ex;
+    ex.hands = cards::Binomial(cards::CardsInDeck, cards::CardsInHand);
+    ex.partnerships = cards::Binomial(cards::CardsInDeck, 2 * cards::CardsInHand);
+    for (int p = 0; p <= MaxPoints; ++p)
+        ex.points[p] = PointCombinations(cards::CardsInHand, p);
+    for (int p = 0; p <= MaxPartnershipPoints; ++p)
+        ex.partnershipPoints[p] = PointCombinations(2 * cards::CardsInHand, p);
+    for (int s = 0; s < LengthStates; ++s) {
+        for (int h = 0; h < LengthStates; ++h) {
+            for (int d = 0; d < LengthStates; ++d) {
+                int c = cards::CardsInHand - s - h - d;
+                if (c >= 0 && c < LengthStates)
+                    ex.shapes[ShapeIndex(s, h, d)] = cards::Binomial(cards::CardsInSuit, s) *
+                                                     cards::Binomial(cards::CardsInSuit, h) *
+                                                     cards::Binomial(cards::CardsInSuit, d) *
+                                                     cards::Binomial(cards::CardsInSuit, c);
+                // the same lengths for a partnership's 26 cards
+                int c2 = 2 * cards::CardsInHand - s - h - d;
+                if (c2 >= 0 && c2 < LengthStates)
+                    ex.longestFit[std::max({s, h, d, c2})] +=
+                        cards::Binomial(cards::CardsInSuit, s) * cards::Binomial(cards::CardsInSuit, h) *
+                        cards::Binomial(cards::CardsInSuit, d) * cards::Binomial(cards::CardsInSuit, c2);
+            }
+        }
+    }
+    return ex;
+}
+
+// Histograms of deals [0, count) of stream 0 under seed, each thread adding
+// to its own copy. The result doesn't depend on the number of threads.
+inline histograms Simulate(std::uint64_t seed, std::uint64_t count,
+                           unsigned threads = workers::DefaultThreads()) {
+    enum { Block = 4096 };
+    threads = std::max(1u, threads);
+    std::vector<histograms> perThread(threads);
+    workers::ParallelFor(
+        (count + Block - 1) / Block, threads,
+        [&](std::size_t block, unsigned worker) {
+            partial::seatsampler sampler(
+                {position::south, position::west, position::north, position::east});
+            cards::counter_rng rng(seed, 0);
+            histograms &h = perThread[worker];
+            std::uint64_t last = std::min<std::uint64_t>(count, (block + 1) * Block);
+            for (std::uint64_t i = block * Block; i < last; ++i) {
+                rng.Seek(i);
+                h.AddDeal(sampler.Sample(rng));
+            }
+        },
+        1);
+    for (unsigned t = 1; t < threads; ++t)
+        perThread[0].Merge(perThread[t]);
+    return perThread[0];
+}
+
+// An estimated probability with its standard error
+struct estimate {
+    double value = 0;
+    double error = 0;
+    std::uint64_t deals = 0;
+
+    double HalfWidth(double z = 1.96) const { return z * error; }
+    double Low(double z = 1.96) const { return value - HalfWidth(z); }
+    double High(double z = 1.96) const { return value + HalfWidth(z); }
+};
+
+// Mean and variance of samples added one at a time (Welford), and combined
+// with another accumulator's (Chan et al.)
+struct running {
+    std::uint64_t n = 0;
+    double mean = 0;
+    double m2 = 0;
+
+    void Add(double x) {
+        ++n;
+        double d = x - mean;
+        mean += d / n;
+        m2 += d * (x - mean);
+    }
+
+    void Merge(const running &o) {
+        if (o.n == 0)
+            return;
+        std::uint64_t total = n + o.n;
+        double d = o.mean - mean;
+        mean += d * o.n / total;
+        m2 += o.m2 + d * d * (static_cast<double>(n) * o.n / total);
+        n = total;
+    }
+
+    double Variance() const { return n > 1 ? m2 / (n - 1) : 0; }
+
+    estimate Estimate() const { return {mean, n ? std::sqrt(Variance() / n) : 0, n}; }
+};
+
+// Adds value(i) for i in [first, first + count). Blocks are merged in order,
+// so the result doesn't depend on the number of threads.
+template <typename F>
+running SampleBlocks(std::uint64_t first, std::uint64_t count, unsigned threads, F &&value) {
+    enum { Block = 4096 };
+    std::vector<running> blocks((count + Block - 1) / Block);
+    workers::ParallelFor(
+        blocks.size(), std::max(1u, threads),
+        [&](std::size_t b, unsigned) {
+            std::uint64_t end = first + std::min<std::uint64_t>(count, (b + 1) * Block);
+            for (std::uint64_t i = first + b * Block; i < end; ++i)
+                blocks[b].Add(value(i));
+        },
+        1);
+    running total;
+    for (const auto &r : blocks)
+        total.Merge(r);
+    return total;
+}
+
+// Runs batch(first, count), which returns a running, in rounds until the 95%
+// interval is no wider than halfWidth or maxDeals have been used
+template <typename Batch>
+estimate Until(double halfWidth, std::uint64_t maxDeals, Batch &&batch,
+               std::uint64_t round = 1 << 14) {
+    running total;
+    while (total.n < maxDeals) {
+        total.Merge(batch(total.n, std::min(round, maxDeals - total.n)));
+        if (total.n > 1 && total.Estimate().HalfWidth() <= halfWidth)
+            break;
+    }
+    return total.Estimate();
+}
+
+// Deals the 13 - known cards each seat lacks from pool, in seat order
+template <typename Seats>
+void Scatter(partial::hands &h, std::uint64_t pool, const Seats &seats, cards::counter_rng &rng) {
+    std::array<cards::CardInt, cards::CardsInDeck> deck;
+    int size = 0;
+    for (; pool; pool &= pool - 1)
+        deck[size++] = static_cast<cards::CardInt>(std::countr_zero(pool));
+    int i = 0;
+    for (int seat : seats) {
+        for (int k = cards::CardsInHand - std::popcount(h[seat]); k > 0; --k, ++i) {
+            std::swap(deck[i], deck[i + rng.Below(size - i)]);
+            h[seat] |= std::uint64_t{1} << deck[i];
+        }
+    }
+}
+
+inline partial::hands RotateSeats(const partial::hands &h, int by) {
+    partial::hands out;
+    for (int p = 0; p < cards::numPlayers; ++p)
+        out[(p + by) % cards::numPlayers] = h[p];
+    return out;
+}
+
+// Clubs become diamonds, diamonds hearts and so on round to spades becoming
+// clubs, `by` times
+inline partial::hands CycleSuits(const partial::hands &h, int by) {
+    int shift = (by % cards::SuitsInDeck) * cards::CardsInSuit;
+    if (shift == 0)
+        return h;
+    partial::hands out;
+    for (int p = 0; p < cards::numPlayers; ++p)
+        out[p] = ((h[p] << shift) | (h[p] >> (cards::CardsInDeck - shift))) &
+                 ((std::uint64_t{1} << cards::CardsInDeck) - 1);
+    return out;
+}
+
+// Each deal can be scored with its transformed copies and the results averaged
+// as one sample. Rotating seats pairs a partnership's good deals with its
+// opponents' and so cancels much of the noise in partnership questions.
+enum class antithetic { none, rotateSeats, cycleSuits };
+
+// The fraction of uniform deals for which pred(hands) holds
+template <typename Pred>
+running Sample(std::uint64_t seed, std::uint64_t first, std::uint64_t count, Pred &&pred,
+               antithetic a = antithetic::none, unsigned threads = workers::DefaultThreads()) {
+    return SampleBlocks(first, count, threads, [&](std::uint64_t i) {
+        cards::counter_rng rng(seed, 0, i);
+        partial::hands h{};
+        Scatter(h, (std::uint64_t{1} << cards::CardsInDeck) - 1, std::array{0, 1, 2, 3}, rng);
+        if (a == antithetic::none)
+            return pred(static_cast<const partial::hands &>(h)) ? 1.0 : 0.0;
+        int hits = 0;
+        for (int k = 0; k < 4; ++k)
+            hits += pred(a == antithetic::rotateSeats ? RotateSeats(h, k) : CycleSuits(h, k));
+        return hits / 4.0;
+    });
+}
+
+template <typename Pred>
+estimate Estimate(std::uint64_t seed, std::uint64_t count, Pred &&pred,
+                  antithetic a = antithetic::none, unsigned threads = workers::DefaultThreads()) {
+    return Sample(seed, 0, count, pred, a, threads).Estimate();
+}
+
+// Stratified by the shape pattern of one seat: each pattern gets its share of
+// the deals (at least two) and the strata are combined with their exact
+// probabilities, so the luck of the patterns drawn drops out of the error
+template <typename Pred>
+estimate EstimateStratified(std::uint64_t seed, std::uint64_t count, position seat, Pred &&pred,
+                            unsigned threads = workers::DefaultThreads()) {
+    const histograms exact = Exact();
+    std::vector<std::pair<pattern, double>> strata;
+    for (auto [p, ways] : exact.Patterns())
+        strata.emplace_back(p, static_cast<double>(ways) / exact.hands);
+    std::array<int, 3> others;
+    for (int k = 1; k < cards::numPlayers; ++k)
+        others[k - 1] = (static_cast<int>(seat) + k) % cards::numPlayers;
+
+    estimate e;
+    double variance = 0;
+    for (std::size_t s = 0; s < strata.size(); ++s) {
+        auto [pat, probability] = strata[s];
+        auto n = std::max<std::uint64_t>(2, std::llround(count * probability));
+        running r = SampleBlocks(0, n, threads, [&](std::uint64_t i) {
+            cards::counter_rng rng(seed, static_cast<std::uint32_t>(s + 1), i);
+            std::array<int, cards::SuitsInDeck> lengths;
+            for (int k = 0; k < cards::SuitsInDeck; ++k)
+                lengths[k] = (pat >> (12 - 4 * k)) & 0xf;
+            for (int k = cards::SuitsInDeck - 1; k > 0; --k)
+                std::swap(lengths[k], lengths[rng.Below(k + 1)]);
+            partial::hands h{};
+            std::uint64_t &mine = h[static_cast<int>(seat)];
+            for (int suit = 0; suit < cards::SuitsInDeck; ++suit) {
+                std::array<int, cards::CardsInSuit> ranks;
+                std::iota(ranks.begin(), ranks.end(), 0);
+                for (int k = 0; k < lengths[suit]; ++k) {
+                    std::swap(ranks[k], ranks[k + rng.Below(cards::CardsInSuit - k)]);
+                    mine |= std::uint64_t{1} << (suit * cards::CardsInSuit + ranks[k]);
+                }
+            }
+            Scatter(h, ((std::uint64_t{1} << cards::CardsInDeck) - 1) & ~mine, others, rng);
+            return pred(static_cast<const partial::hands &>(h)) ? 1.0 : 0.0;
+        });
+        e.value += probability * r.mean;
+        variance += probability * probability * r.Variance() / r.n;
+        e.deals += r.n;
+    }
+    e.error = std::sqrt(variance);
+    return e;
+}
+
+// Deals in which a group of seats, one hand or a partnership, gets its cards
+// from a tilted distribution over the group's suit lengths and point count:
+// a class is drawn with probability proportional to its true probability
+// times tilt(lengths, points), then the cards uniformly within the class.
+// Sample returns the deal with the likelihood ratio that undoes the tilt.
+// The tilt mustn't be zero for any class in which the event can happen.
+class tiltedsampler {
+  private:
+    enum { SuitPoints = 10, PointStates = MaxPartnershipPoints + 1, Classes = Shapes * PointStates };
+    using lengths = std::array<int, cards::SuitsInDeck>;
+    using pointways = std::array<double, PointStates>;
+    std::vector<int> group;
+    std::vector<int> rest;
+    int size = 0;
+    // ways to hold a number of cards of one suit with each point count
+    std::array<pointways, LengthStates> suitWays{};
+    std::vector<double> probability; // of each class
+    std::vector<double> cumulative;  // of the tilted probabilities
+    std::vector<double> weight;
+
+  public:
+    template <typename Tilt>
+    tiltedsampler(std::initializer_list<position> seats, Tilt &&tilt)
+        : probability(Classes), cumulative(Classes), weight(Classes) {
+        for (position p : seats) {
+            assert(std::find(group.begin(), group.end(), static_cast<int>(p)) == group.end());
+            group.push_back(static_cast<int>(p));
+        }
+        size = static_cast<int>(group.size()) * cards::CardsInHand;
+        assert(size > 0 && size <= 2 * cards::CardsInHand);
+        for (int p = 0; p < cards::numPlayers; ++p) {
+            if (std::find(group.begin(), group.end(), p) == group.end())
+                rest.push_back(p);
+        }
+        for (int honours = 0; honours < 16; ++honours) {
+            int held = std::popcount(static_cast<unsigned>(honours));
+            for (int l = held; l < LengthStates; ++l)
+                suitWays[l][HonourPoints(honours)] += cards::Binomial(cards::CardsInSuit - 4, l - held);
+        }
+        double all = static_cast<double>(cards::Binomial(cards::CardsInDeck, size));
+        double tilted = 0;
+        for (int shape = 0; shape < Shapes; ++shape) {
+            lengths l;
+            pointways ways{};
+            if (Decode(shape, l))
+                ways = Convolve(Convolve(suitWays[l[0]], suitWays[l[1]]),
+                                Convolve(suitWays[l[2]], suitWays[l[3]]));
+            for (int points = 0; points < PointStates; ++points) {
+                int c = shape * PointStates + points;
+                probability[c] = ways[points] / all;
+                if (probability[c] > 0) {
+                    double t = tilt(static_cast<const lengths &>(l), points);
+                    assert(t >= 0);
+                    weight[c] = t > 0 ? 1 / t : 0;
+                    tilted += probability[c] * t;
+                }
+                cumulative[c] = tilted;
+            }
+        }
+        assert(tilted > 0);
+        for (auto &w : weight)
+            w *= tilted;
+    }
+
+    // The exact probability of the classes for which pred(lengths, points) holds
+    template <typename Pred> double Probability(Pred &&pred) const {
+        double total = 0;
+        for (int c = 0; c < Classes; ++c) {
+            lengths l;
+            if (probability[c] > 0 && Decode(c / PointStates, l) &&
+                pred(static_cast<const lengths &>(l), c % PointStates))
+                total += probability[c];
+        }
+        return total;
+    }
+
+    std::pair<partial::hands, double> Sample(cards::counter_rng &rng) const {
+        double u = Uniform(rng) * cumulative.back();
+        int c = static_cast<int>(std::upper_bound(cumulative.begin(), cumulative.end(), u) -
+                                 cumulative.begin());
+        for (c = std::min(c, Classes - 1); weight[c] == 0;) // nothing to the right but empty classes
+            --c;
+        lengths l;
+        Decode(c / PointStates, l);
+        int points = c % PointStates;
+
+        // the points of each suit in turn, weighted by the ways to finish
+        // the class with the suits after it
+        std::array<pointways, cards::SuitsInDeck> after;
+        after[3] = {};
+        after[3][0] = 1;
+        for (int s = 2; s >= 0; --s)
+            after[s] = Convolve(suitWays[l[s + 1]], after[s + 1]);
+        std::uint64_t held = 0;
+        for (int s = 0; s < cards::SuitsInDeck; ++s) {
+            pointways choice{};
+            for (int x = 0; x <= std::min<int>(points, SuitPoints); ++x)
+                choice[x] = suitWays[l[s]][x] * after[s][points - x];
+            int x = Pick(choice, rng);
+            points -= x;
+
+            std::array<double, 16> honourChoice{};
+            for (int honours = 0; honours < 16; ++honours) {
+                int n = std::popcount(static_cast<unsigned>(honours));
+                if (HonourPoints(honours) == x && n <= l[s])
+                    honourChoice[honours] = cards::Binomial(cards::CardsInSuit - 4, l[s] - n);
+            }
+            int honours = Pick(honourChoice, rng);
+            std::uint64_t suitCards = static_cast<std::uint64_t>(honours) << (cards::CardsInSuit - 4);
+            std::array<int, cards::CardsInSuit - 4> spots;
+            std::iota(spots.begin(), spots.end(), 0);
+            for (int k = 0; k < l[s] - std::popcount(static_cast<unsigned>(honours)); ++k) {
+                std::swap(spots[k], spots[k + rng.Below(static_cast<std::uint32_t>(spots.size()) - k)]);
+                suitCards |= std::uint64_t{1} << spots[k];
+            }
+            held |= suitCards << (s * cards::CardsInSuit);
+        }
+
+        partial::hands h{};
+        Scatter(h, held, group, rng);
+        Scatter(h, ((std::uint64_t{1} << cards::CardsInDeck) - 1) & ~held, rest, rng);
+        return {h, weight[c]};
+    }
+
+  private:
+    // J, Q, K and A as bits 0 to 3
+    static int HonourPoints(int honours) {
+        int points = 0;
+        for (int b = 0; b < 4; ++b)
+            points += (honours >> b & 1) * (b + 1);
+        return points;
+    }
+
+    static pointways Convolve(const pointways &a, const pointways &b) {
+        pointways out{};
+        for (int i = 0; i < PointStates; ++i) {
+            if (a[i] == 0)
+                continue;
+            for (int j = 0; i + j < PointStates; ++j)
+                out[i + j] += a[i] * b[j];
+        }
+        return out;
+    }
+
+    static double Uniform(cards::counter_rng &rng) {
+        std::uint64_t hi = rng();
+        std::uint64_t lo = rng();
+        return static_cast<double>(hi << 21 ^ lo >> 11) * 0x1p-53;
+    }
+
+    template <typename W> static int Pick(const W &weights, cards::counter_rng &rng) {
+        double total = 0;
+        for (double w : weights)
+            total += w;
+        double u = Uniform(rng) * total;
+        int last = 0;
+        for (int i = 0; i < static_cast<int>(weights.size()); ++i) {
+            if (weights[i] <= 0)
+                continue;
+            last = i;
+            if ((u -= weights[i]) < 0)
+                break;
+        }
+        return last;
+    }
+
+    bool Decode(int shape, lengths &l) const {
+        l[2] = shape % LengthStates;
+        l[1] = shape / LengthStates % LengthStates;
+        l[0] = shape / LengthStates / LengthStates;
+        l[3] = size - l[0] - l[1] - l[2];
+        return l[3] >= 0 && l[3] < LengthStates;
+    }
+};
+
+// Importance sampling: the weighted fraction of tilted deals for which
+// pred(hands) holds
+template <typename Pred>
+running SampleTilted(std::uint64_t seed, std::uint64_t first, std::uint64_t count,
+                     const tiltedsampler &sampler, Pred &&pred,
+                     unsigned threads = workers::DefaultThreads()) {
+    return SampleBlocks(first, count, threads, [&](std::uint64_t i) {
+        cards::counter_rng rng(seed, 0, i);
+        auto [h, weight] = sampler.Sample(rng);
+        return pred(static_cast<const partial::hands &>(h)) ? weight : 0.0;
+    });
+}
+
+template <typename Pred>
+estimate EstimateTilted(std::uint64_t seed, std::uint64_t count, const tiltedsampler &sampler,
+                        Pred &&pred, unsigned threads = workers::DefaultThreads()) {
+    return SampleTilted(seed, 0, count, sampler, pred, threads).Estimate();
+}
+} // namespace stats
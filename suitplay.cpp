@@ -0,0 +1,370 @@
+module;
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+export module suitplay;
+
+import cards;
+
+// Single suit play for one partnership (north/south) against best defence.
+// Every split of the missing cards between west and east is enumerated with
+// its exact a priori probability (vacant places: west has 13 - k spaces for
+// the other suits when it holds k of these). Declarer doesn't see the split,
+// so each decision is made once for every split still consistent with the
+// cards seen; the defenders see everything and play to each split's worst
+// case. Decisions are picked by "vector minimax": the choice whose vector of
+// results over the live splits scores best. Declarer is assumed to be able to
+// lead from either hand at every trick.
+export namespace suitplay {
+using cards::position;
+using rankmask = std::uint16_t; // bit r set for rank r, 0 the two and 12 the ace
+
+enum { MaxExpected = 0 }; // target for maximising expected tricks
+
+inline rankmask Ranks(const std::vector<cards::Card> &cs) {
+    rankmask m = 0;
+    for (const auto &c : cs) {
+        assert(cs.front().Suit() == c.Suit());
+        m |= 1 << c.val();
+    }
+    return m;
+}
+
+// "AQT2", or "-" for a void
+inline std::string RanksToString(rankmask m) {
+    std::string out;
+    for (int r = cards::CardsInSuit - 1; r >= 0; --r) {
+        if (m & (1 << r))
+            out += cards::CardVal[r];
+    }
+    return out.empty() ? "-" : out;
+}
+
+inline std::optional<rankmask> RanksFromString(const std::string &s) {
+    if (s == "-")
+        return rankmask{0};
+    rankmask m = 0;
+    for (char c : s) {
+        auto pos = cards::CardVal.find(c);
+        if (pos == std::string_view::npos || (m & (1 << pos)))
+            return {};
+        m |= 1 << pos;
+    }
+    return s.empty() ? std::nullopt : std::optional<rankmask>(m);
+}
+
+// Probability that west holds one particular westCards of the missing cards
+inline double SplitProbability(int westCards, int missing) {
+    return static_cast<double>(cards::Binomial(cards::CardsInDeck / 2 - missing,
+                                               cards::CardsInHand - westCards)) /
+           cards::Binomial(cards::CardsInDeck / 2, cards::CardsInHand);
+}
+
+struct split {
+    rankmask west;
+    rankmask east;
+    double probability;
+    int tricks; // for north/south with the chosen line
+};
+
+struct suitresult {
+    double probability = 0;    // of making the target, 1 when maximising expected tricks
+    double expectedTricks = 0;
+    position leader = position::south; // hand to lead first
+    int leadRank = -1;         // -1 with no cards to play
+    std::vector<split> splits; // not kept when loaded from a table
+};
+
+class suitsolver {
+  private:
+    enum { North, South, West, East };
+
+    // Cards still held by north and south, seen from each defender, and
+    // whether a defender has shown out
+    struct state {
+        std::array<rankmask, 4> cards; // north/south remaining, west/east played
+        std::array<bool, 2> shownOut{};
+    };
+
+    using values = std::vector<signed char>; // tricks from here, per split
+
+    rankmask missing = 0;
+    int target = MaxExpected;
+    std::vector<rankmask> westHolds;
+    std::vector<double> weight;
+    std::unordered_map<std::uint64_t, values> memo;
+    std::map<std::tuple<rankmask, rankmask, int>, suitresult> cache;
+
+    static constexpr std::array<int, 4> lho = {East, West, North, South};
+
+    rankmask Holding(int seat, std::size_t w) const {
+        return seat == West ? westHolds[w] : missing & ~westHolds[w];
+    }
+
+    bool Live(const state &st, std::size_t w) const {
+        for (int d : {West, East}) {
+            rankmask h = Holding(d, w);
+            if ((h & st.cards[d]) != st.cards[d] || (st.shownOut[d - West] && h != st.cards[d]))
+                return false;
+        }
+        return true;
+    }
+
+    // Probability of making the target (or nothing), then expected tricks
+    std::pair<double, double> Score(const values &v, const state &st, int needed) const {
+        double make = 0, expected = 0;
+        for (std::size_t w = 0; w < v.size(); ++w) {
+            if (!Live(st, w))
+                continue;
+            if (target != MaxExpected && v[w] >= needed)
+                make += weight[w];
+            expected += weight[w] * v[w];
+        }
+        return {make, expected};
+    }
+
+    rankmask Unplayed(const state &st) const {
+        return st.cards[North] | st.cards[South] | (missing & ~(st.cards[West] | st.cards[East]));
+    }
+
+    // The lowest card of each run of cards equivalent within hand
+    static std::vector<int> Choices(rankmask hand, rankmask unplayed) {
+        std::vector<int> out;
+        for (int r = 0; r < cards::CardsInSuit; ++r) {
+            if (!(hand & (1 << r)))
+                continue;
+            int below = r - 1;
+            while (below >= 0 && !(unplayed & (1 << below)))
+                --below;
+            if (below < 0 || !(hand & (1 << below)))
+                out.push_back(r);
+        }
+        return out;
+    }
+
+    values TrickStart(const state &st, int needed) {
+        values out(westHolds.size(), 0);
+        if (!st.cards[North] && !st.cards[South])
+            return out;
+        needed = target == MaxExpected ? 0 : std::max(needed, 0);
+        std::uint64_t key = std::uint64_t{st.cards[North]} | std::uint64_t{st.cards[South]} << 13 |
+                            std::uint64_t{st.cards[West]} << 26 | std::uint64_t{st.cards[East]} << 39 |
+                            std::uint64_t{st.shownOut[0]} << 52 | std::uint64_t{st.shownOut[1]} << 53 |
+                            std::uint64_t(needed) << 54;
+        if (auto it = memo.find(key); it != memo.end())
+            return it->second;
+        int best = -1;
+        Lead(st, needed, best, out);
+        memo.emplace(key, out);
+        return out;
+    }
+
+    // Best lead from either hand; best gets the lead as hand * 16 + rank
+    void Lead(const state &st, int needed, int &best, values &out) {
+        std::pair<double, double> bestScore{-1, -1};
+        for (int hand : {South, North}) {
+            for (int r : Choices(st.cards[hand], Unplayed(st))) {
+                std::array<int, 4> trick{-1, -1, -1, -1};
+                trick[hand] = r;
+                state next = st;
+                next.cards[hand] &= ~(1 << r);
+                values v = Play(next, trick, hand, lho[hand], 1, needed);
+                auto score = Score(v, st, needed);
+                if (score > bestScore) {
+                    bestScore = score;
+                    best = hand * 16 + r;
+                    out = std::move(v);
+                }
+            }
+        }
+    }
+
+    values Play(const state &st, std::array<int, 4> &trick, int leader, int seat, int played,
+                int needed) {
+        if (played == 4) {
+            int winner = std::distance(trick.begin(), std::max_element(trick.begin(), trick.end()));
+            int won = winner == North || winner == South ? 1 : 0;
+            values v = TrickStart(st, needed - won);
+            for (auto &x : v)
+                x += won;
+            return v;
+        }
+        int next = lho[seat];
+        if (seat == North || seat == South) {
+            if (!st.cards[seat])
+                return Play(st, trick, leader, next, played + 1, needed);
+            values best;
+            std::pair<double, double> bestScore{-1, -1};
+            // Cards already in the trick still separate this hand's cards
+            rankmask present = Unplayed(st);
+            for (int c : trick) {
+                if (c >= 0)
+                    present |= 1 << c;
+            }
+            for (int r : Choices(st.cards[seat], present)) {
+                state after = st;
+                after.cards[seat] &= ~(1 << r);
+                trick[seat] = r;
+                values v = Play(after, trick, leader, next, played + 1, needed);
+                trick[seat] = -1;
+                auto score = Score(v, st, needed);
+                if (score > bestScore) {
+                    bestScore = score;
+                    best = std::move(v);
+                }
+            }
+            return best;
+        }
+
+        // A defender: every split gets the worst of the cards it allows
+        values out(westHolds.size(), cards::CardsInSuit + 1);
+        rankmask options = 0;
+        bool canShowOut = false;
+        for (std::size_t w = 0; w < westHolds.size(); ++w) {
+            if (!Live(st, w))
+                continue;
+            rankmask left = Holding(seat, w) & ~st.cards[seat];
+            options |= left;
+            canShowOut = canShowOut || !left;
+        }
+        for (int r = 0; r < cards::CardsInSuit; ++r) {
+            if (!(options & (1 << r)))
+                continue;
+            state after = st;
+            after.cards[seat] |= 1 << r;
+            trick[seat] = r;
+            values v = Play(after, trick, leader, next, played + 1, needed);
+            trick[seat] = -1;
+            for (std::size_t w = 0; w < v.size(); ++w) {
+                if (Live(after, w))
+                    out[w] = std::min(out[w], v[w]);
+            }
+        }
+        if (canShowOut) {
+            state after = st;
+            after.shownOut[seat - West] = true;
+            values v = Play(after, trick, leader, next, played + 1, needed);
+            for (std::size_t w = 0; w < v.size(); ++w) {
+                if (Live(after, w))
+                    out[w] = std::min(out[w], v[w]);
+            }
+        }
+        return out;
+    }
+
+  public:
+    // target is the north/south tricks wanted, or MaxExpected
+    suitresult Solve(rankmask north, rankmask south, int target = MaxExpected) {
+        assert(!(north & south));
+        auto key = std::make_tuple(north, south, target);
+        if (auto it = cache.find(key); it != cache.end())
+            return it->second;
+
+        this->target = target;
+        missing = ((1 << cards::CardsInSuit) - 1) & ~(north | south);
+        int n = std::popcount(missing);
+        westHolds.resize(std::size_t{1} << n);
+        weight.resize(westHolds.size());
+        for (std::size_t w = 0; w < westHolds.size(); ++w) {
+            rankmask west = 0;
+            rankmask pool = missing;
+            for (std::size_t bits = w; bits; bits >>= 1, pool &= pool - 1) {
+                if (bits & 1)
+                    west |= pool & -pool;
+            }
+            westHolds[w] = west;
+            weight[w] = SplitProbability(std::popcount(west), n);
+        }
+        memo.clear();
+
+        state st;
+        st.cards = {north, south, 0, 0};
+        values v(westHolds.size(), 0);
+        int best = -1;
+        if (north || south)
+            Lead(st, target, best, v);
+        memo.clear();
+
+        suitresult res;
+        auto [make, expected] = Score(v, st, target);
+        res.probability = target == MaxExpected ? 1.0 : make;
+        res.expectedTricks = expected;
+        if (best >= 0) {
+            res.leader = best / 16 == North ? position::north : position::south;
+            res.leadRank = best % 16;
+        }
+        for (std::size_t w = 0; w < westHolds.size(); ++w)
+            res.splits.push_back({westHolds[w], static_cast<rankmask>(missing & ~westHolds[w]), weight[w], v[w]});
+        cache.emplace(key, res);
+        return res;
+    }
+
+    suitresult Solve(const std::vector<cards::Card> &north, const std::vector<cards::Card> &south,
+                     int target = MaxExpected) {
+        assert(north.empty() || south.empty() || north.front().Suit() == south.front().Suit());
+        return Solve(Ranks(north), Ranks(south), target);
+    }
+
+    std::size_t size() const { return cache.size(); }
+
+    // One line per solved holding:
+    // <north> <south> <target> <probability> <expected tricks> <N|S> <lead rank>
+    void Save(std::ostream &os) const {
+        auto precision = os.precision(17);
+        for (const auto &[key, r] : cache) {
+            auto [north, south, t] = key;
+            os << RanksToString(north) << ' ' << RanksToString(south) << ' ' << t << ' '
+               << r.probability << ' ' << r.expectedTricks << ' '
+               << (r.leader == position::north ? 'N' : 'S') << ' '
+               << (r.leadRank < 0 ? '-' : cards::CardVal[r.leadRank]) << '\n';
+        }
+        os.precision(precision);
+    }
+
+    // Adds the results of a saved table; returns the first bad line, if any
+    std::optional<int> Load(std::istream &is) {
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(is, line)) {
+            ++lineNumber;
+            line = line.substr(0, line.find('#'));
+            if (line.find_first_not_of(" \t\r") == std::string::npos)
+                continue;
+            std::istringstream fields(line);
+            std::string northText, southText, leader, lead, extra;
+            int t;
+            suitresult r;
+            if (!(fields >> northText >> southText >> t >> r.probability >> r.expectedTricks >> leader >>
+                  lead) ||
+                fields >> extra)
+                return lineNumber;
+            auto north = RanksFromString(northText);
+            auto south = RanksFromString(southText);
+            if (!north || !south || (*north & *south) || (leader != "N" && leader != "S") ||
+                lead.size() != 1)
+                return lineNumber;
+            r.leader = leader == "N" ? position::north : position::south;
+            auto rank = cards::CardVal.find(lead[0]);
+            if (lead != "-" && (rank == std::string_view::npos || !((leader == "N" ? *north : *south) & (1 << rank))))
+                return lineNumber;
+            r.leadRank = lead == "-" ? -1 : static_cast<int>(rank);
+            cache[std::make_tuple(*north, *south, t)] = r;
+        }
+        return {};
+    }
+};
+} // namespace suitplay
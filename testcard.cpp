@@ -1,7 +1,31 @@
 module;
 
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <ranges>
+#include <span>
+#include <sstream>
+#include <thread>
+#include <type_traits>
 import cards;
+import agents;
+import boards;
+import bench;
+import bidding;
+import database;
+import generator;
+import partial;
+import scoring;
+import sink;
+import solver;
+import stats;
+import suitplay;
+import workers;
 
 export module testcard;
 
@@ -578,6 +602,1942 @@ int TestTricks() {
     return testsFailed;
 }
 
+int TestRandomStreams() {
+
+    int testsFailed = 0;
+    int testNumber = 0;
+
+    auto Test = [&testsFailed, &testNumber](const bool result, const std::string &description) {
+        if (!result) {
+            std::cout << "Test Random failed " << testNumber << " " << description << "\n";
+            ++testsFailed;
+        }
+        ++testNumber;
+        return result;
+    };
+
+    {
+        // Known answers from the Random123 distribution
+        using ctr = cards::philox4x32::counter_type;
+        Test(cards::philox4x32::Generate({0, 0, 0, 0}, {0, 0}) ==
+                 ctr{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8},
+             "philox zero vector");
+        Test(cards::philox4x32::Generate({0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+                                         {0xffffffff, 0xffffffff}) ==
+                 ctr{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd},
+             "philox ones vector");
+        Test(cards::philox4x32::Generate({0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344},
+                                         {0xa4093822, 0x299f31d0}) ==
+                 ctr{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1},
+             "philox pi vector");
+    }
+
+    {
+        cards::deal d1(42, 7, 1000000000000ULL);
+        cards::deal d2(42, 7, 1000000000000ULL);
+        Test(d1 == d2, "same seed, stream and index give the same deal");
+        Test(d1.to_link() == d2.to_link(), "same link");
+
+        cards::deal d3(42, 8, 1000000000000ULL);
+        cards::deal d4(43, 7, 1000000000000ULL);
+        cards::deal d5(42, 7, 1000000000001ULL);
+        Test(d1 != d3, "streams differ");
+        Test(d1 != d4, "seeds differ");
+        Test(d1 != d5, "indices differ");
+
+        int points = 0;
+        for (const auto &h : d1.hands)
+            points += h.PointCount();
+        Test(points == 40, "shuffled deck is still a deck");
+    }
+
+    {
+        // Regenerating from the middle of a stream matches generating in order
+        cards::counter_rng rng(5, 1);
+        cards::deal d;
+        bool same = true;
+        for (std::uint64_t k = 0; k < 20; ++k) {
+            rng.Seek(k);
+            d.Deal(rng);
+            same = same && (d == cards::deal(5, 1, k));
+        }
+        Test(same, "sequential and random access agree");
+    }
+
+    {
+        cards::counter_rng rng(1, 0);
+        bool inrange = true;
+        for (int i = 0; i < 1000; ++i)
+            inrange = inrange && (rng.Below(52) < 52);
+        Test(inrange, "Below stays in range");
+    }
+
+    {
+        const std::uint64_t total = 10;
+        std::uint64_t next = 0;
+        for (std::uint64_t s = 0; s < 3; ++s) {
+            auto r = cards::ShardRange(total, 3, s);
+            Test(r.first == next, "shards are contiguous");
+            next = r.first + r.count;
+        }
+        Test(next == total, "shards cover every deal");
+    }
+
+    return testsFailed;
+}
+
+int TestDealSource() {
+
+    int testsFailed = 0;
+    int testNumber = 0;
+
+    auto Test = [&testsFailed, &testNumber](const bool result, const std::string &description) {
+        if (!result) {
+            std::cout << "Test DealSource failed " << testNumber << " " << description << "\n";
+            ++testsFailed;
+        }
+        ++testNumber;
+        return result;
+    };
+
+    using cards::position;
+
+    {
+        int n = 0;
+        bool same = true;
+        for (const auto &ld : cards::dealsource(9, 3, 100, 10)) {
+            cards::deal d(9, 3, 100 + n);
+            same = same && ld.GetIndex() == 100u + n;
+            for (int p = 0; p < cards::numPlayers; ++p) {
+                auto pos = static_cast<position>(p);
+                same = same && ld.GetHand(pos) == d.hands[p];
+                same = same && ld.PointCount(pos) == d.hands[p].PointCount();
+                same = same && ld.SuitLength(pos, cards::suit::hearts) == d.hands[p].SuitLength(2);
+            }
+            same = same && ld.ToDeal() == d;
+            ++n;
+        }
+        Test(n == 10, "source yields count deals");
+        Test(same, "lazy deals match seeded deals");
+    }
+
+    {
+        auto strong = [](const cards::lazydeal &d) { return d.PointCount(position::south) >= 20; };
+        auto indices = cards::dealsource(9, 0) | std::views::filter(strong) | std::views::take(3) |
+                       std::views::transform([](const cards::lazydeal &d) { return d.GetIndex(); });
+        int n = 0;
+        bool ok = true;
+        for (auto k : indices) {
+            ok = ok && cards::deal(9, 0, k).hands[0].PointCount() >= 20;
+            ++n;
+        }
+        Test(n == 3, "take stops the pipeline");
+        Test(ok, "filter sees the right hands");
+    }
+
+    {
+        auto empty = cards::dealsource(1, 1, 5, 0);
+        Test(empty.begin() == empty.end(), "empty source");
+        cards::deal ordered(cards::OrderedDeck());
+        Test(ordered.hands[0].Mask() == 0x1fff && ordered.hands[3].Mask() == std::uint64_t{0x1fff} << 39,
+             "deal from a deck as it lies");
+    }
+
+    return testsFailed;
+}
+
+int TestBoards() {
+
+    int testsFailed = 0;
+    int testNumber = 0;
+
+    auto Test = [&testsFailed, &testNumber](const bool result, const std::string &description) {
+        if (!result) {
+            std::cout << "Test Boards failed " << testNumber << " " << description << "\n";
+            ++testsFailed;
+        }
+        ++testNumber;
+        return result;
+    };
+
+    using cards::position;
+    using cards::vulnerability;
+
+    Test(boards::BoardDealer(1) == position::north, "board 1 dealer");
+    Test(boards::BoardDealer(4) == position::west, "board 4 dealer");
+    Test(boards::BoardDealer(18) == position::east, "board 18 dealer");
+    Test(boards::BoardVulnerability(1) == vulnerability::neither, "board 1 vul");
+    Test(boards::BoardVulnerability(7) == vulnerability::both, "board 7 vul");
+    Test(boards::BoardVulnerability(9) == vulnerability::eastwest, "board 9 vul");
+    Test(boards::BoardVulnerability(16) == vulnerability::eastwest, "board 16 vul");
+    Test(boards::BoardVulnerability(17) == vulnerability::neither, "board 17 vul");
+
+    {
+        boards::boardset set(77, 3, 32);
+        Test(set.size() == 32, "set size");
+        const auto &b5 = set.GetBoards()[4];
+        Test(b5.number == 5, "board numbers");
+        Test(b5.d.contrct.GetDealer() == position::north, "dealer rotates");
+        Test(b5.d.GetVulnerability() == vulnerability::northsouth, "vulnerability rotates");
+
+        boards::boardset again(77, 3, 1, 5);
+        Test(again.GetBoards()[0].d == b5.d, "board regenerates on its own");
+
+        set.Annotate(2);
+        bool annotated = true;
+        for (const auto &b : set.GetBoards()) {
+            annotated = annotated && b.stats && b.stats->points[0] == b.d.hands[0].PointCount();
+            annotated = annotated && b.stats->fitNorthSouth >= 7 && b.stats->fitEastWest >= 7;
+        }
+        Test(annotated, "annotation");
+
+        auto rec = boards::ToBinary(b5);
+        auto back = boards::FromBinary(rec);
+        Test(back.number == 5 && back.d == b5.d, "binary round trip");
+        Test(back.d.to_link() == b5.d.to_link(), "binary keeps dealer and vulnerability");
+
+        std::ostringstream bin;
+        set.Write(bin, boards::format::binary);
+        Test(bin.str().size() == 32 * boards::BinaryRecordSize, "binary batch size");
+
+        std::ostringstream pbn;
+        boards::boardset(77, 3, 1).Write(pbn, boards::format::pbn);
+        Test(pbn.str().find("[Dealer \"N\"]\n[Vulnerable \"None\"]") != std::string::npos,
+             "pbn header");
+        Test(pbn.str().find("[Deal \"S:") != std::string::npos, "pbn deal");
+
+        std::ostringstream lin;
+        boards::boardset(77, 3, 2).Write(lin, boards::format::lin);
+        Test(lin.str().find("ah|Board 2|") != std::string::npos, "lin board name");
+    }
+
+    {
+        auto sets = boards::MakeSets(5, 10, 4, 16, true, 3);
+        Test(sets.size() == 4, "number of sets");
+        Test(sets[2].GetBoards()[0].d == boards::boardset(5, 12, 1).GetBoards()[0].d,
+             "sets made in parallel match sets made alone");
+    }
+
+    {
+        cards::deal d(1, 1, 1);
+        std::string pbn = d.to_pbn();
+        Test(pbn.size() == 2 + 4 * (13 + 3) + 3, "pbn deal length");
+    }
+
+    return testsFailed;
+}
+
+cards::Hand MakeHand(const std::string &st) {
+    cards::Hand h;
+    std::istringstream is(st);
+    std::string cd;
+    for (auto &c : h.crd) {
+        is >> cd;
+        c = cards::MakeCard(cd);
+    }
+    h.SetSuits();
+    return h;
+}
+
+int TestBidding() {
+
+    int testsFailed = 0;
+    int testNumber = 0;
+
+    auto Test = [&testsFailed, &testNumber](const bool result, const std::string &description) {
+        if (!result) {
+            std::cout << "Test Bidding failed " << testNumber << " " << description << "\n";
+            ++testsFailed;
+        }
+        ++testNumber;
+        return result;
+    };
+
+    Test(cards::bid("7S").IsValid() && *cards::bid("7S").bidSize() == 7, "seven level suit bid");
+    Test(cards::bid::FromCallIndex(cards::bid("7NT").CallIndex()).to_link() == "7NT",
+         "call index round trip");
+
+    const auto spades = MakeHand("AS KS QS JS 2S AH 3H 4D 5D 6D 2C 3C 4C"); // 14, 5 spades
+    const auto weak = MakeHand("9S 8S 7S 2S 5H 4H 3H 9D 8D 7D 9C 8C KC");  // 3 points
+    const auto raise = MakeHand("9S 8S 7S AH KH 3H 2H 9D 8D 7D 9C 8C 2C"); // 7, 3 spades
+
+    {
+        bidding::handconstraint c;
+        c.SetPoints(12, 14);
+        c.SetLength(cards::suit::spades, 5, 13);
+        Test(c.Matches(bidding::handfeatures(spades)), "in range at the top");
+        c.SetPoints(15, 17);
+        Test(!c.Matches(bidding::handfeatures(spades)), "below range");
+        c.SetPoints(14, 14);
+        c.SetLength(cards::suit::spades, 6, 13);
+        Test(!c.Matches(bidding::handfeatures(spades)), "suit too short");
+        c.SetLength(cards::suit::spades, 0, 4);
+        Test(!c.Matches(bidding::handfeatures(spades)), "suit too long");
+
+        bidding::handconstraint h;
+        h.Require(cards::MakeCard("AS"));
+        Test(h.Matches(bidding::handfeatures(spades)), "has the ace");
+        h.Exclude(cards::MakeCard("KS"));
+        Test(!h.Matches(bidding::handfeatures(spades)), "must not have the king");
+    }
+
+    std::istringstream rules(R"(# a tiny system
+: hcp 15-17 spades 2-4 hearts 2-4 diamonds 2-5 clubs 2-5 => 1NT
+: hcp 12-21 spades 5-13 => 1S
+: hcp 12-21 => 1C
+1S P : hcp 6-9 spades 3-13 => 2S
+1S P : hcp 6-9 => 1C   # not legal, never chosen
+1S P : hcp 6-9 => 1NT
+1S P 2S P : hcp 16-21 with AS => 4S
+* : => P
+)");
+    bidding::bidder b;
+    Test(!b.Load(rules), "rules load");
+    Test(b.NumAuctions() == 3, "three auctions");
+
+    {
+        cards::contract c;
+        c.SetDealer(cards::position::south);
+        Test(b.ChooseBid(spades, c)->to_link() == "1S", "open one spade");
+        Test(b.ChooseBid(weak, c)->IsPass(), "weak hand passes");
+
+        c.AddBid(cards::bid("1S"));
+        c.AddBid(cards::bid("P"));
+        Test(b.ChooseBid(raise, c)->to_link() == "2S", "raise partner");
+        auto shortSpades = MakeHand("9S 8S AH KH 3H 2H 9D 8D 7D 6D 9C 8C 2C");
+        Test(b.ChooseBid(shortSpades, c)->to_link() == "1NT", "illegal call is skipped");
+    }
+
+    {
+        cards::deal d(cards::position::south);
+        d.hands[0] = spades;
+        d.hands[1] = weak;
+        d.hands[2] = raise;
+        d.hands[3] = weak;
+        b.BidDeal(d);
+        Test(d.contrct.finalContract.IsValid(), "auction finishes");
+        Test(d.contrct.finalContract.to_link() == "2S", "one spade, two spades");
+        Test(!cards::IsOpponent(d.contrct.declarer, cards::position::south), "our contract");
+
+        auto shown = b.Infer(d.contrct);
+        const auto &opener = shown[static_cast<int>(cards::position::south)];
+        const auto &responder = shown[static_cast<int>(cards::position::north)];
+        Test(opener.GetLow(bidding::PointsLane) == 12 && opener.GetHigh(bidding::PointsLane) == 21 &&
+                 opener.GetLow(bidding::LengthLane + 3) == 5,
+             "opener shows 12-21 and five spades");
+        Test(responder.GetLow(bidding::PointsLane) == 6 && responder.GetHigh(bidding::PointsLane) == 9 &&
+                 responder.GetLow(bidding::LengthLane + 3) == 3,
+             "responder shows 6-9 and three spades");
+        Test(shown[1].Matches(bidding::handfeatures(spades)) && shown[3].Matches(bidding::handfeatures(raise)),
+             "passes show nothing");
+        for (int p = 0; p < cards::numPlayers; ++p)
+            Test(shown[p].Matches(bidding::handfeatures(d.hands[p])), "every hand fits what it showed");
+    }
+
+    {
+        cards::contract c;
+        c.SetDealer(cards::position::south);
+        Test(!b.Shows(c, cards::bid("2NT")), "no rule makes the call");
+        c.AddBid(cards::bid("1S"));
+        c.AddBid(cards::bid("P"));
+        auto nt = b.Shows(c, cards::bid("1NT"));
+        Test(nt && nt->GetHigh(bidding::PointsLane) == 9 && nt->GetHigh(bidding::LengthLane + 3) == bidding::LaneTop,
+             "1NT response shows points only");
+
+        bidding::handconstraint x, y;
+        x.SetPoints(6, 9);
+        x.Require(cards::MakeCard("AS"));
+        y.SetPoints(12, 14);
+        y.SetLength(cards::suit::spades, 5, 13);
+        y.Require(cards::MakeCard("AS"));
+        auto hull = x;
+        hull.Widen(y);
+        Test(hull.GetLow(bidding::PointsLane) == 6 && hull.GetHigh(bidding::PointsLane) == 14 &&
+                 hull.GetLow(bidding::LengthLane + 3) == 0 && hull.required == x.required,
+             "widened to both");
+        x.Intersect(y);
+        Test(!x.Matches(bidding::handfeatures(spades)) && !x.Matches(bidding::handfeatures(raise)),
+             "crossed ranges match nothing");
+    }
+
+    {
+        std::istringstream bad("1S : hcp 6-9 => 2S\n1S P : points 6-9 => 2S\n");
+        bidding::bidder b2;
+        auto err = b2.Load(bad);
+        Test(err && *err == 2, "bad line reported");
+        std::istringstream bad2(": hcp 9-6 => 2S");
+        Test(bool(b2.Load(bad2)), "reversed range");
+        std::istringstream bad3(": hcp 6-9 => 8S");
+        Test(bool(b2.Load(bad3)), "bad call");
+    }
+
+    return testsFailed;
+}
+
+int TestAuctionTrie() {
+
+    int testsFailed = 0;
+    int testNumber = 0;
+
+    auto Test = [&testsFailed, &testNumber](const bool result, const std::string &description) {
+        if (!result) {
+            std::cout << "Test AuctionTrie failed " << testNumber << " " << description << "\n";
+            ++testsFailed;
+        }
+        ++testNumber;
+        return result;
+    };
+
+    bidding::auctiontrie<int> trie;
+    Test(trie.size() == cards::numPlayers, "one root per dealer");
+
+    {
+        auto root = trie.Root(cards::position::west);
+        auto n1 = trie.Child(root, cards::bid("1H"));
+        auto n2 = trie.Child(root, cards::bid("1H"));
+        Test(n1 && n2 && *n1 == *n2, "prefixes are interned");
+        Test(!trie.Child(*n1, cards::bid("1C")), "insufficient bid rejected");
+        Test(!trie.Child(*n1, cards::bid("R")), "nothing to redouble");
+        auto n3 = trie.Child(*n1, cards::bid("D"));
+        const auto &node = trie.Node(*n3);
+        Test(node.nextToBid == cards::position::east, "next to bid");
+        Test(node.doubled == 1 && node.Contract()->to_link() == "1H", "doubled one heart");
+        Test(node.Contract()->GetBidder() == cards::position::west, "contract bidder");
+        Test(!node.IsLegal(cards::bid("D")), "can't double twice");
+        Test(node.IsLegal(cards::bid("R")), "can redouble");
+        trie.Data(*n3) = 42;
+        Test(trie.Data(*trie.Find(*n1, cards::bid("D"))) == 42, "data hangs off the node");
+    }
+
+    {
+        // Random legal auctions agree with contract::NextBidValid call by call
+        cards::counter_rng rng(3, 0);
+        bool agree = true;
+        bool roundTrip = true;
+        for (int a = 0; a < 300; ++a) {
+            cards::contract c;
+            c.SetDealer(static_cast<cards::position>(a % cards::numPlayers));
+            auto id = trie.Root(c.GetDealer());
+            while (!c.finalContract.IsValid()) {
+                const auto &n = trie.Node(id);
+                for (int i = 0; i < cards::bid::NumCalls; ++i) {
+                    auto b = cards::bid::FromCallIndex(i);
+                    agree = agree && (c.NextBidValid(b) == n.IsLegal(b));
+                }
+                // Mostly passes and doubles so auctions end and get doubled
+                int i = rng.Below(3) == 0 ? rng.Below(cards::bid::NumCalls) : rng.Below(3);
+                auto b = cards::bid::FromCallIndex(i);
+                if (!n.IsLegal(b))
+                    continue;
+                c.AddBid(b);
+                id = *trie.Child(id, b);
+            }
+            agree = agree && trie.Node(id).finished && trie.Node(id).legal == 0;
+            roundTrip = roundTrip && trie.Intern(c) == id;
+            auto back = trie.ToContract(id);
+            roundTrip = roundTrip && back.bids == c.bids && back.finalContract == c.finalContract;
+        }
+        Test(agree, "legal call masks match NextBidValid");
+        Test(roundTrip, "intern and rebuild auctions");
+        auto before = trie.size();
+        cards::contract c;
+        c.SetDealer(cards::position::south);
+        for (auto call : {"P", "P", "P", "P"})
+            c.AddBid(cards::bid(call));
+        trie.Intern(c);
+        trie.Intern(c);
+        Test(trie.size() <= before + 4, "repeated auctions share nodes");
+    }
+
+    return testsFailed;
+}
+
+// North/south tricks by trying every legal card, for checking the solver
+int BruteForceTricks(const solver::playstate &ps) {
+    if (ps.TricksLeft() == 0)
+        return 0;
+    bool ns = solver::NorthSouth(static_cast<int>(ps.ToMove()));
+    int best = ns ? -1 : cards::CardsInHand + 1;
+    for (std::uint64_t m = ps.LegalCards(); m; m &= m - 1) {
+        solver::playstate next = ps;
+        auto won = next.Play(std::countr_zero(m));
+        int v = BruteForceTricks(next) + ((won && solver::NorthSouth(static_cast<int>(*won))) ? 1 : 0);
+        best = ns ? std::max(best, v) : std::min(best, v);
+    }
+    return best;
+}
+
+// Each seat gets `size` cards of a shuffled deck
+solver::playstate RandomEnding(cards::counter_rng &rng, int size, int trumps) {
+    cards::Deck deck = cards::OrderedDeck();
+    cards::ShuffleDeck(deck, rng);
+    solver::playstate ps;
+    for (int p = 0; p < cards::numPlayers; ++p) {
+        for (int i = 0; i < size; ++i)
+            ps.hands[p] |= solver::Bit(deck[p * cards::CardsInHand + i]);
+    }
+    ps.trumps = trumps;
+    ps.leader = static_cast<cards::position>(rng.Below(cards::numPlayers));
+    return ps;
+}
+
+int TestSolver() {
+
+    int testsFailed = 0;
+    int testNumber = 0;
+
+    auto Test = [&testsFailed, &testNumber](const bool result, const std::string &description) {
+        if (!result) {
+            std::cout << "Test Solver failed " << testNumber << " " << description << "\n";
+            ++testsFailed;
+        }
+        ++testNumber;
+        return result;
+    };
+
+    using cards::position;
+    solver::solver dds;
+
+    {
+        cards::counter_rng rng(11, 0);
+        bool same = true;
+        bool cardsAgree = true;
+        for (int k = 0; k < 60; ++k) {
+            rng.Seek(k);
+            auto ps = RandomEnding(rng, 4, k % (solver::NoTrumps + 1));
+            // Start some of them part way through a trick
+            for (int i = 0; i < k % cards::numPlayers; ++i)
+                ps.Play(std::countr_zero(ps.LegalCards()));
+            int ns = BruteForceTricks(ps);
+            same = same && dds.Tricks(ps, position::north) == ns;
+            same = same && dds.Tricks(ps, position::east) == ps.TricksLeft() - ns;
+
+            int best = -1;
+            for (const auto &r : dds.CardTricks(ps))
+                best = std::max(best, r.tricks);
+            cardsAgree = cardsAgree && best == dds.Tricks(ps, ps.ToMove());
+        }
+        Test(same, "solver agrees with brute force");
+        Test(cardsAgree, "best card gives the position's value");
+    }
+
+    {
+        // Every trick is won by the ace, king, queen, ... of spades or hearts
+        solver::playstate ps;
+        const std::array<std::string, cards::numPlayers> seats = {
+            "AS KS QS JS TS 9S 8S 7S 6S 5S 4S 3S 2S", "AH KH QH JH TH 9H 8H 7H 6H 5H 4H 3H 2H",
+            "AD KD QD JD TD 9D 8D 7D 6D 5D 4D 3D 2D", "AC KC QC JC TC 9C 8C 7C 6C 5C 4C 3C 2C"};
+        for (int p = 0; p < cards::numPlayers; ++p)
+            ps.hands[p] = MakeHand(seats[p]).Mask();
+        ps.leader = position::west;
+        ps.trumps = solver::NoTrumps;
+        Test(dds.Tricks(ps, position::west) == 13, "long suit on lead takes everything");
+        ps.trumps = static_cast<int>(cards::suit::spades);
+        Test(dds.Tricks(ps, position::south) == 13, "trumps take everything");
+    }
+
+    {
+        cards::deal d(21, 0, 0);
+        auto ps = solver::MakePlayState(d, solver::NoTrumps, position::west);
+        int ns = dds.Tricks(ps, position::north);
+        int ew = dds.Tricks(ps, position::west);
+        Test(ns + ew == cards::CardsInHand, "full deal tricks add up");
+    }
+
+    {
+        // Opening lead against 3NT by south
+        solver::leadproblem prob;
+        prob.contrct.SetDealer(position::south);
+        for (auto call : {"1NT", "P", "3NT", "P", "P", "P"})
+            prob.contrct.AddBid(cards::bid(call));
+        prob.leaderHand = MakeHand("AS KS QS JS TS 5H 4H 3H 5D 4D 3D 3C 2C");
+        prob.constraints[static_cast<int>(position::south)].SetPoints(15, 17);
+        Test(prob.contrct.declarer == position::south, "declarer named notrumps first");
+        cards::contract raised;
+        raised.SetDealer(position::north);
+        cards::ParseAuction("1H P 1S P 2H P 3S P 4S P P P", raised);
+        Test(raised.declarer == position::south, "declarer named spades first");
+
+        auto sum = solver::SimulateLeads(prob, 8, 1, 4);
+        Test(sum.samples == 8, "all samples solved");
+        Test(sum.leads.size() == cards::CardsInHand, "every card has a result");
+        Test(sum.leads[0].card.Suit() == cards::suit::spades, "lead the solid suit");
+        Test(sum.leads[0].setPercent == 100.0, "and beat 3NT every time");
+        auto again = solver::SimulateLeads(prob, 8, 1, 1);
+        Test(again.leads[0].averageTricks == sum.leads[0].averageTricks, "thread count doesn't matter");
+    }
+
+    {
+        // South opened one spade and north raised; how high should south go?
+        std::istringstream rules(": hcp 12-21 spades 5-13 => 1S\n1S P : hcp 6-9 spades 3-13 => 2S\n");
+        bidding::bidder b;
+        b.Load(rules);
+        cards::contract auction;
+        auction.SetDealer(position::south);
+        for (auto call : {"1S", "P", "2S", "P"})
+            auction.AddBid(cards::bid(call));
+        auto hand = MakeHand("AS KS QS JS 2S AH KH 3H AD 5D 6D 2C 3C");
+        auto prob = solver::MakeContractProblem(b, auction, hand, position::south, cards::vulnerability::neither);
+        Test(prob.constraints[static_cast<int>(position::north)].GetLow(bidding::PointsLane) == 6,
+             "partner's raise read from the auction");
+        for (auto call : {"2S", "4S", "7S", "3NT"})
+            prob.candidates.push_back({cards::bid(call), position::south});
+
+        auto sum = solver::SimulateContracts(prob, 12, 3, 4);
+        Test(sum.samples == 12 && sum.attempts > sum.samples, "constrained layouts solved");
+        Test(sum.contracts.size() == 4, "every candidate has a result");
+        auto find = [&](const char *call) {
+            return *std::ranges::find_if(sum.contracts, [&](const solver::contractresult &r) {
+                return r.choice.contract.to_link() == call;
+            });
+        };
+        Test(find("2S").averageTricks == find("4S").averageTricks, "same strain, same tricks");
+        Test(find("2S").makePercent >= find("4S").makePercent && find("7S").makePercent < 100,
+             "higher contracts make less often");
+        Test(sum.contracts[0].averageScore >= sum.contracts[3].averageScore, "best first");
+        auto again = solver::SimulateContracts(prob, 12, 3, 1);
+        Test(again.contracts[0].averageScore == sum.contracts[0].averageScore, "thread count doesn't matter");
+    }
+
+    {
+        std::vector<int> visits(1001);
+        workers::StealingFor(visits.size(), 4, [&](std::size_t i, unsigned) { ++visits[i]; }, 7);
+        Test(std::ranges::all_of(visits, [](int v) { return v == 1; }), "work stealing runs each index once");
+        int none = 0;
+        workers::StealingFor(0, 4, [&](std::size_t, unsigned) { ++none; });
+        Test(none == 0, "nothing to do");
+    }
+
+    {
+        // Deals with seven tricks to go, the first six played with the lowest legal cards
+        std::vector<cards::deal> deals;
+        for (int i = 0; i < 12; ++i) {
+            cards::deal d(21, 0, i);
+            position leader = position::west;
+            for (int n = 0; n < 6; ++n) {
+                cards::trick t;
+                t.SetLeadPos(leader);
+                t.SetNoTrumps();
+                position seat = leader;
+                for (int k = 0; k < cards::numPlayers; ++k, seat = cards::Lefty(seat)) {
+                    const cards::Hand &h = d.hands[static_cast<int>(seat)];
+                    int c = 0;
+                    while (h.crd[c].CardHasPlayed() || !cards::CardIsValidFromHand(h, t, c))
+                        ++c;
+                    t.PlayCard(h.crd[c]);
+                }
+                d.AddTrick(t);
+                leader = *t.WonBy();
+            }
+            deals.push_back(d);
+        }
+        auto tables = solver::SolveTables(deals, 3);
+        bool right = tables.size() == deals.size();
+        for (std::size_t i = 0; i < deals.size() && right; ++i) {
+            solver::solver fresh;
+            for (int strain = 0; strain <= solver::NoTrumps; ++strain) {
+                for (int p = 0; p < cards::numPlayers; ++p) {
+                    auto declarer = static_cast<position>(p);
+                    auto ps = solver::MakePlayState(deals[i], strain, cards::Lefty(declarer));
+                    right = right && tables[i].Tricks(strain, declarer) == fresh.Tricks(ps, declarer);
+                }
+            }
+        }
+        Test(right, "trick tables");
+        Test(solver::SolveTables(deals, 1) == tables, "thread count doesn't matter");
+        Test(solver::SolveTable(dds, deals[5]) == tables[5], "one deal");
+        Test(solver::SolveTables(std::span<const cards::deal>(), 2).empty(), "no deals");
+    }
+
+    return testsFailed;
+}
+
+// Plays a deal out through the trick records, each card chosen by pick
+template <typename F> void PlayOut(cards::deal &d, F pick) {
+    auto ps = solver::MakePlayState(d, solver::Strain(d.contrct.finalContract),
+                                    cards::Lefty(d.contrct.declarer));
+    while (ps.TricksLeft() > 0) {
+        cards::trick t;
+        t.SetLeadPos(ps.leader);
+        t.InitFromContract(d.contrct);
+        for (int i = 0; i < cards::numPlayers; ++i) {
+            int c = pick(ps);
+            t.PlayCard(cards::Card{static_cast<cards::CardInt>(c)});
+            ps.Play(c);
+        }
+        d.AddTrick(t);
+    }
+}
+
+int TestReview() {
+
+    int testsFailed = 0;
+    int testNumber = 0;
+
+    auto Test = [&testsFailed, &testNumber](const bool result, const std::string &description) {
+        if (!result) {
+            std::cout << "Test Review failed " << testNumber << " " << description << "\n";
+            ++testsFailed;
+        }
+        ++testNumber;
+        return result;
+    };
+
+    using cards::position;
+    std::vector<boards::board> played;
+    for (int n = 1; n <= 4; ++n) {
+        boards::board b{n, cards::deal(6, 0, n), {}};
+        b.d.contrct.SetDealer(position::south);
+        for (auto call : {n % 2 ? "1NT" : "2H", "P", "P", "P"})
+            b.d.contrct.AddBid(cards::bid(call));
+        // Everyone plays their lowest legal card
+        PlayOut(b.d, [](const solver::playstate &ps) { return std::countr_zero(ps.LegalCards()); });
+        played.push_back(b);
+    }
+    Test(played[0].d.GetTricksPlayed() == cards::CardsInHand, "whole deal played");
+
+    auto reviews = solver::ReviewBoards(played, 2);
+    Test(reviews.size() == played.size(), "one review per board");
+    solver::solver dds;
+    for (std::size_t i = 0; i < reviews.size(); ++i) {
+        const auto &costs = reviews[i].costs;
+        if (!Test(costs && costs->size() == cards::CardsInDeck, "every card reviewed"))
+            continue;
+        const cards::deal &d = played[i].d;
+        cards::deal fresh(6, 0, reviews[i].number);
+        auto ps = solver::MakePlayState(fresh, solver::Strain(d.contrct.finalContract),
+                                        cards::Lefty(d.contrct.declarer));
+        // What the play lost against double dummy, side by side
+        int balance = dds.Tricks(ps, position::north);
+        int won = 0;
+        bool nonNegative = true;
+        for (const auto &cc : *costs) {
+            nonNegative = nonNegative && cc.cost >= 0;
+            balance += solver::NorthSouth(static_cast<int>(cc.player)) ? -cc.cost : cc.cost;
+            if (auto w = ps.Play(cc.card); w && solver::NorthSouth(static_cast<int>(*w)))
+                ++won;
+        }
+        Test(nonNegative, "a card can't gain tricks for its own side");
+        Test(balance == won, "costs account for the result");
+    }
+    Test(solver::ReviewBoards({played[0]}, 1)[0].costs == reviews[0].costs, "same with one thread");
+
+    {
+        // Best play throughout costs nothing
+        cards::deal d(5, 1, 3);
+        d.contrct.SetDealer(position::south);
+        for (auto call : {"1S", "P", "P", "P"})
+            d.contrct.AddBid(cards::bid(call));
+        PlayOut(d, [&dds](const solver::playstate &ps) {
+            auto results = dds.CardTricks(ps);
+            return std::ranges::max(results, {}, &solver::solver::cardresult::tricks).card;
+        });
+        auto costs = solver::ReviewPlay(dds, d);
+        Test(costs && std::ranges::all_of(*costs, [](const auto &cc) { return cc.cost == 0; }),
+             "best play costs nothing");
+
+        cards::deal unplayed(5, 1, 3);
+        Test(solver::ReviewPlay(dds, unplayed) == std::nullopt, "no contract, no review");
+    }
+
+    {
+        std::stringstream ss;
+        solver::WriteReviews(ss, reviews);
+        solver::WriteReviews(ss, {{9, {}}});
+        bool same = true;
+        for (const auto &r : reviews) {
+            auto back = solver::ReadReview(ss);
+            same = same && back && back->number == r.number && back->costs->size() == r.costs->size();
+            for (std::size_t k = 0; same && k < r.costs->size(); ++k) {
+                same = (*back->costs)[k].card == (*r.costs)[k].card &&
+                       (*back->costs)[k].cost == (*r.costs)[k].cost;
+            }
+        }
+        Test(same, "review stream reads back");
+        auto bad = solver::ReadReview(ss);
+        Test(bad && bad->number == 9 && !bad->costs, "unreviewable board reads back");
+        Test(!solver::ReadReview(ss), "end of stream");
+    }
+
+    return testsFailed;
+}
+
+int TestCompletions() {
+
+    int testsFailed = 0;
+    int testNumber = 0;
+
+    auto Test = [&testsFailed, &testNumber](const bool result, const std::string &description) {
+        if (!result) {
+            std::cout << "Test Completions failed " << testNumber << " " << description << "\n";
+            ++testsFailed;
+        }
+        ++testNumber;
+        return result;
+    };
+
+    using cards::position;
+    Test(cards::Binomial(52, 13) == 635013559600ULL, "hands in a deck");
+    Test(partial::UnrankCombination(0, 10, 3) == 0b111, "first combination");
+    Test(partial::UnrankCombination(cards::Binomial(10, 3) - 1, 10, 3) == 0b1110000000,
+         "last combination");
+    Test(partial::NextCombination(0b1011) == 0b1101, "next combination");
+    Test(partial::Deposit(0b101, 0b11010) == 0b10010, "deposit");
+
+    // Declarer and dummy known
+    cards::deal d(3, 0, 0);
+    partial::partialdeal p;
+    p.Know(position::south, d.hands[static_cast<int>(position::south)]);
+    p.Know(position::north, d.hands[static_cast<int>(position::north)]);
+    partial::completions all(p);
+    Test(all.size() == cards::Binomial(26, 13), "26 cards split between two hands");
+
+    bool fits = true;
+    bool walkMatches = true;
+    std::uint64_t last = 0;
+    for (std::uint64_t first : {std::uint64_t{0}, std::uint64_t{12345}, all.size() - 40}) {
+        all.Walk(first, 40, [&](std::uint64_t i, const partial::hands &h) {
+            fits = fits && p.Fits(h);
+            walkMatches = walkMatches && h == all.Unrank(i);
+            walkMatches = walkMatches && (i == first || i == last + 1);
+            last = i;
+        });
+    }
+    Test(fits, "completions keep the known cards, 13 cards each");
+    Test(walkMatches, "walking agrees with unranking");
+    Test(all.Unrank(0) != all.Unrank(1), "different completions");
+
+    {
+        // West's share of the unknown spades follows the hypergeometric law exactly
+        std::uint64_t spades = p.Unknown() & cards::SuitMask(cards::suit::spades);
+        int n = std::popcount(spades);
+        auto count = partial::CountCompletions(
+            p, [spades](const partial::hands &h) { return std::popcount(h[1] & spades) == 2; }, 4);
+        Test(count.total == all.size(), "every completion counted");
+        Test(count.matching == cards::Binomial(n, 2) * cards::Binomial(26 - n, 11), "exact split count");
+    }
+
+    {
+        // One hand known: three seats to fill
+        partial::partialdeal one;
+        one.Know(position::west, d.hands[1]);
+        partial::completions rest(one);
+        Test(rest.size() == cards::Binomial(39, 13) * cards::Binomial(26, 13), "39 unknown cards");
+        auto h = rest.Unrank(rest.size() - 1);
+        Test(one.Fits(h) && (h[0] | h[1] | h[2] | h[3]) == (std::uint64_t{1} << 52) - 1,
+             "last completion is a deal");
+        bool stepped = true;
+        rest.Walk(rest.size() / 3, 200, [&](std::uint64_t i, const partial::hands &hh) {
+            stepped = stepped && hh == rest.Unrank(i);
+        });
+        Test(stepped, "walk carries between seats");
+
+        partial::partialdeal bad = one;
+        bad.Know(position::east, d.hands[1]);
+        Test(!bad.IsValid(), "a card can't be in two hands");
+    }
+
+    {
+        partial::partialdeal full;
+        for (int s = 0; s < cards::numPlayers; ++s)
+            full.Know(static_cast<position>(s), d.hands[s]);
+        partial::completions only(full);
+        Test(only.size() == 1 && only.Unrank(0) == full.known, "a whole deal has one completion");
+    }
+
+    {
+        // Only south dealt
+        partial::seatsampler south({position::south});
+        cards::counter_rng rng(8, 0);
+        long long points = 0;
+        bool onlySouth = true;
+        for (int i = 0; i < 4000; ++i) {
+            auto h = south.Sample(rng);
+            onlySouth = onlySouth && std::popcount(h[0]) == cards::CardsInHand && !(h[1] | h[2] | h[3]);
+            points += cards::MaskPointCount(h[0]);
+        }
+        Test(onlySouth, "one hand of 13 cards");
+        Test(points > 4000 * 9.7 && points < 4000 * 10.3, "ten points on average");
+
+        cards::Hand hand = south.SampleHand(rng);
+        Test(hand.PointCount() == cards::MaskPointCount(hand.Mask()), "sampled hand");
+        cards::counter_rng first(9, 0), second(9, 0);
+        partial::seatsampler other({position::south});
+        Test(south.Sample(first) == other.Sample(second), "same stream, same hand");
+
+        // East/west around a known north/south
+        partial::seatsampler defence(p, {position::west, position::east});
+        auto h = defence.Sample(rng);
+        Test(p.Fits(h) && (h[0] | h[1] | h[2] | h[3]) == (std::uint64_t{1} << 52) - 1,
+             "partnership completes the deal");
+    }
+
+    return testsFailed;
+}
+
+int TestSuitPlay() {
+
+    int testsFailed = 0;
+    int testNumber = 0;
+
+    auto Test = [&testsFailed, &testNumber](const bool result, const std::string &description) {
+        if (!result) {
+            std::cout << "Test SuitPlay failed " << testNumber << " " << description << "\n";
+            ++testsFailed;
+        }
+        ++testNumber;
+        return result;
+    };
+
+    auto near = [](double a, double b) { return a > b - 1e-9 && a < b + 1e-9; };
+    auto ranks = [](const std::string &s) { return *suitplay::RanksFromString(s); };
+
+    Test(suitplay::RanksToString(ranks("AQT2")) == "AQT2", "ranks round trip");
+    Test(!suitplay::RanksFromString("AQX") && !suitplay::RanksFromString("AA"), "bad ranks");
+
+    suitplay::suitsolver solver;
+    {
+        // The finesse
+        auto r = solver.Solve({cards::MakeCard("AS"), cards::MakeCard("QS")},
+                              {cards::MakeCard("3S"), cards::MakeCard("2S")}, 2);
+        Test(near(r.probability, 0.5), "finesse is 50%");
+        Test(r.leader == cards::position::south, "lead towards the tenace");
+        double total = 0;
+        for (const auto &sp : r.splits)
+            total += sp.probability;
+        Test(r.splits.size() == 512 && near(total, 1.0), "every split, probabilities add up");
+        Test(near(solver.Solve(ranks("AQ"), ranks("32")).expectedTricks, 1.5), "expected tricks");
+    }
+
+    {
+        // Five tricks need a 3-2 break
+        double threeTwo = 20.0 * cards::Binomial(21, 11) / cards::Binomial(26, 13);
+        auto r = solver.Solve(ranks("AKQ65"), ranks("432"), 5);
+        Test(near(r.probability, threeTwo), "3-2 break");
+        Test(solver.Solve(ranks("AK765"), ranks("432"), 5).probability == 0, "no fifth trick");
+        Test(near(solver.Solve(ranks("AKQJ"), ranks("-"), 4).probability, 1), "solid suit");
+    }
+
+    {
+        std::size_t solved = solver.size();
+        solver.Solve(ranks("AKQ65"), ranks("432"), 5);
+        Test(solver.size() == solved, "results kept by holding");
+
+        std::stringstream table;
+        solver.Save(table);
+        suitplay::suitsolver loaded;
+        Test(!loaded.Load(table) && loaded.size() == solved, "table loads");
+        auto r = loaded.Solve(ranks("AQ"), ranks("32"), 2);
+        Test(near(r.probability, 0.5) && r.leader == cards::position::south && r.splits.empty(),
+             "looked up, not solved");
+
+        std::stringstream bad("AQ 32 2 0.5 1.5 S 2\nAQ 32 2 0.5 1.5 S K\n");
+        Test(loaded.Load(bad) == 2, "lead must be in the leader's hand");
+    }
+
+    return testsFailed;
+}
+
+int TestStats() {
+
+    int testsFailed = 0;
+    int testNumber = 0;
+
+    auto Test = [&testsFailed, &testNumber](const bool result, const std::string &description) {
+        if (!result) {
+            std::cout << "Test Stats failed " << testNumber << " " << description << "\n";
+            ++testsFailed;
+        }
+        ++testNumber;
+        return result;
+    };
+
+    auto near = [](double a, double b, double eps) { return a > b - eps && a < b + eps; };
+
+    Test(stats::PatternOf({3, 4, 2, 4}) == 0x4432, "pattern sorted");
+    Test(stats::PatternToString(0x4432) == "4-4-3-2", "pattern text");
+
+    stats::histograms exact = stats::Exact();
+    auto sum = [](const auto &a) {
+        std::uint64_t t = 0;
+        for (auto v : a)
+            t += v;
+        return t;
+    };
+    Test(sum(exact.points) == exact.hands && sum(exact.shapes) == exact.hands, "every hand counted");
+    Test(sum(exact.partnershipPoints) == exact.partnerships && sum(exact.longestFit) == exact.partnerships,
+         "every holding counted");
+    Test(exact.points[0] == cards::Binomial(36, 13) && exact.points[stats::MaxPoints] == 4,
+         "yarborough and the biggest hands");
+    std::uint64_t weighted = 0;
+    for (int p = 0; p <= stats::MaxPoints; ++p)
+        weighted += p * exact.points[p];
+    Test(weighted == 10 * exact.hands, "ten points on average");
+    Test(near(exact.PatternShare(0x4333), 0.105361, 1e-6), "4-3-3-3");
+    Test(near(exact.PatternShare(0x4432), 0.215511, 1e-6), "4-4-3-2");
+    Test(exact.longestFit[6] == 0 && exact.longestFit[7] > 0, "a partnership always has a 7 card fit");
+
+    stats::histograms one = stats::Simulate(11, 10000, 1);
+    stats::histograms many = stats::Simulate(11, 10000, 4);
+    Test(one == many, "threads don't change the result");
+    Test(one.hands == 40000 && one.partnerships == 20000, "four hands and two partnerships a deal");
+    double worst = 0;
+    for (int p = 0; p <= stats::MaxPoints; ++p)
+        worst = std::max(worst, std::abs(one.PointsShare(p) - exact.PointsShare(p)));
+    Test(worst < 0.01, "points match the exact distribution");
+    Test(near(one.PatternShare(0x4432), exact.PatternShare(0x4432), 0.01), "patterns match");
+    for (int f = 7; f <= cards::CardsInSuit; ++f)
+        Test(near(one.FitShare(f), exact.FitShare(f), 0.015), "fits match " + std::to_string(f));
+
+    stats::histograms fromDeal;
+    fromDeal.AddDeal(cards::deal(5, 1, 3));
+    Test(fromDeal.hands == 4 && sum(fromDeal.partnershipPoints) == 2, "add a deal");
+
+    return testsFailed;
+}
+
+int TestSampling() {
+
+    int testsFailed = 0;
+    int testNumber = 0;
+
+    auto Test = [&testsFailed, &testNumber](const bool result, const std::string &description) {
+        if (!result) {
+            std::cout << "Test Sampling failed " << testNumber << " " << description << "\n";
+            ++testsFailed;
+        }
+        ++testNumber;
+        return result;
+    };
+
+    auto near = [](double a, double b, double eps) { return a > b - eps && a < b + eps; };
+
+    stats::running r, left, right;
+    for (int i = 1; i <= 10; ++i) {
+        r.Add(i);
+        (i <= 3 ? left : right).Add(i);
+    }
+    left.Merge(right);
+    Test(near(r.mean, 5.5, 1e-12) && near(r.Variance(), 55.0 / 6, 1e-9), "mean and variance");
+    Test(left.n == 10 && near(left.mean, r.mean, 1e-12) && near(left.m2, r.m2, 1e-9), "merged");
+
+    partial::hands h{1, 2, 4, 8};
+    Test(stats::RotateSeats(h, 1)[1] == 1 && stats::RotateSeats(h, 4) == h, "rotate seats");
+    partial::hands spade{cards::SuitMask(cards::suit::spades), 0, 0, 0};
+    Test(stats::CycleSuits(spade, 1)[0] == cards::SuitMask(cards::suit::clubs) &&
+             stats::CycleSuits(spade, 4) == spade,
+         "cycle suits");
+
+    stats::histograms exact = stats::Exact();
+    auto tail = [](const auto &counts, std::uint64_t total, int from) {
+        std::uint64_t t = 0;
+        for (std::size_t p = from; p < counts.size(); ++p)
+            t += counts[p];
+        return static_cast<double>(t) / total;
+    };
+    auto contains = [](const stats::estimate &e, double v) { return e.Low(4) <= v && v <= e.High(4); };
+
+    // North-South with 26 or more points
+    auto game = [](const partial::hands &d) { return cards::MaskPointCount(d[0] | d[2]) >= 26; };
+    double gameOdds = tail(exact.partnershipPoints, exact.partnerships, 26);
+    auto plain = stats::Estimate(3, 20000, game, stats::antithetic::none, 4);
+    auto rotated = stats::Estimate(3, 20000, game, stats::antithetic::rotateSeats, 4);
+    Test(contains(plain, gameOdds) && contains(rotated, gameOdds), "game odds");
+    Test(rotated.error < plain.error, "rotated pairs reduce the error");
+    Test(stats::Estimate(3, 5000, game, stats::antithetic::rotateSeats, 1).value ==
+             stats::Estimate(3, 5000, game, stats::antithetic::rotateSeats, 3).value,
+         "threads don't change the estimate");
+
+    // South with a five card major
+    auto major = [](const partial::hands &d) {
+        return std::popcount(d[0] & cards::SuitMask(cards::suit::spades)) >= 5 ||
+               std::popcount(d[0] & cards::SuitMask(cards::suit::hearts)) >= 5;
+    };
+    std::uint64_t majorHands = 0;
+    for (int s = 0; s < stats::LengthStates; ++s)
+        for (int hs = 0; hs < stats::LengthStates; ++hs)
+            for (int d = 0; d < stats::LengthStates; ++d)
+                if (s >= 5 || hs >= 5)
+                    majorHands += exact.shapes[stats::ShapeIndex(s, hs, d)];
+    double majorOdds = static_cast<double>(majorHands) / exact.hands;
+    auto stratified = stats::EstimateStratified(5, 20000, cards::position::south, major, 4);
+    Test(contains(stratified, majorOdds), "five card major");
+    Test(stratified.error < stats::Estimate(5, 20000, major).error, "strata reduce the error");
+
+    // A rare one: North-South with a ten card fit and 30 points
+    auto rare = [](const partial::hands &d) {
+        std::uint64_t ns = d[0] | d[2];
+        int fit = 0;
+        for (int s = 0; s < cards::SuitsInDeck; ++s)
+            fit = std::max(fit, std::popcount(ns & cards::SuitMask(static_cast<cards::suit>(s))));
+        return fit >= 10 && cards::MaskPointCount(ns) >= 30;
+    };
+    stats::tiltedsampler tilted({cards::position::south, cards::position::north},
+                                [](const std::array<int, 4> &l, int points) {
+                                    return std::exp(0.4 * points) * (std::ranges::max(l) >= 10 ? 50 : 1);
+                                });
+    double rareOdds = tilted.Probability([](const std::array<int, 4> &l, int points) {
+        return std::ranges::max(l) >= 10 && points >= 30;
+    });
+    Test(near(tilted.Probability([](const auto &, int) { return true; }), 1, 1e-9), "classes sum to one");
+    auto weighted = stats::EstimateTilted(7, 20000, tilted, rare, 4);
+    auto uniform = stats::Estimate(7, 20000, rare);
+    Test(contains(weighted, rareOdds), "rare event");
+    Test(weighted.error * 10 < uniform.error, "importance sampling cuts the error");
+    auto until = stats::Until(rareOdds / 20, 1 << 22, [&](std::uint64_t first, std::uint64_t count) {
+        return stats::SampleTilted(7, first, count, tilted, rare);
+    });
+    Test(until.HalfWidth() <= rareOdds / 20 && until.deals < (1 << 22), "sample until precise");
+
+    return testsFailed;
+}
+
+int TestDatabase() {
+
+    int testsFailed = 0;
+    int testNumber = 0;
+
+    auto Test = [&testsFailed, &testNumber](const bool result, const std::string &description) {
+        if (!result) {
+            std::cout << "Test Database failed " << testNumber << " " << description << "\n";
+            ++testsFailed;
+        }
+        ++testNumber;
+        return result;
+    };
+
+    database::bitmap evens, threes;
+    for (std::uint32_t n = 0; n < 200000; ++n) {
+        if (n % 2 == 0)
+            evens.Add(n);
+        if (n % 3 == 0)
+            threes.Add(n);
+    }
+    Test(evens.Count() == 100000 && evens.Contains(131072) && !evens.Contains(131071), "bitmap add");
+    auto both = evens & threes;
+    Test(both.Count() == 33334 && both.Contains(6) && !both.Contains(4), "bitmap and");
+    Test((evens | threes).Count() == 133333, "bitmap or");
+    database::bitmap few;
+    few.Add(4);
+    few.Add(70001);
+    Test((few & evens).ToVector() == std::vector<std::uint32_t>{4}, "sparse and dense");
+    Test((few | threes).Count() == threes.Count() + 2, "sparse or dense");
+
+    std::vector<boards::board> all;
+    for (const auto &set : boards::MakeSets(9, 0, 70, 1000))
+        all.insert(all.end(), set.GetBoards().begin(), set.GetBoards().end());
+    for (std::size_t i = 0; i < all.size(); ++i) {
+        std::vector<std::string> calls;
+        switch (i % 4) {
+        case 0:
+            calls = {"4S", "P", "P", "P"};
+            break;
+        case 1:
+            calls = {"1N", "D", "P", "P", "P"};
+            break;
+        case 2:
+            calls = {"P", "P", "P", "P"};
+            break;
+        }
+        for (const auto &c : calls)
+            all[i].d.contrct.AddBid(cards::bid(c));
+    }
+    database::dealbase db;
+    db.Add(all);
+    Test(db.size() == 70000, "every board stored");
+
+    using cards::position;
+    using cards::suit;
+    auto scan = [&](auto &&pred) {
+        std::vector<std::uint32_t> out;
+        for (std::uint32_t r = 0; r < db.size(); ++r)
+            if (pred(r))
+                out.push_back(r);
+        return out;
+    };
+
+    database::query majors;
+    majors.Length(position::north, suit::spades, 5, 5)
+        .Length(position::north, suit::hearts, 5, 5)
+        .Points(position::north, 10, 12)
+        .DeclaringSide(position::north)
+        .Game();
+    auto found = db.Find(majors);
+    auto expected = scan([&](std::uint32_t r) {
+        auto b = db.Board(r);
+        const auto &north = b.d.hands[static_cast<int>(position::north)];
+        int declarer = db.Value(database::DeclarerColumn, r);
+        return north.SuitLength(static_cast<int>(suit::spades)) == 5 &&
+               north.SuitLength(static_cast<int>(suit::hearts)) == 5 && north.PointCount() >= 10 &&
+               north.PointCount() <= 12 && r % 4 == 0 &&
+               (declarer == static_cast<int>(position::north) || declarer == static_cast<int>(position::south));
+    });
+    Test(!expected.empty() && found == expected, "5-5 majors, 10-12 and game");
+
+    database::query flat;
+    flat.Pattern(position::south, 0x4333).Points(position::south, 15, 17).Vulnerable(cards::vulnerability::both);
+    Test(db.Find(flat) == scan([&](std::uint32_t r) {
+             return db.Value(database::PatternOf(position::south), r) == database::PatternValue(0x4333) &&
+                    db.Value(database::PointsOf(position::south), r) >= 15 &&
+                    db.Value(database::PointsOf(position::south), r) <= 17 &&
+                    all[r].d.GetVulnerability() == cards::vulnerability::both;
+         }),
+         "flat strong notrump");
+
+    database::query doubled;
+    doubled.Contract(cards::bid("1N")).Where(database::DoubledColumn, database::Range(1, 1));
+    Test(db.Count(doubled) == 17500, "doubled contracts");
+    Test(db.Count(database::query().Where(database::ContractColumn, 1ull << database::NoContract)) == 17500,
+         "no auction");
+    Test(db.Count(database::query()) == db.size(), "no conditions");
+    auto strong = db.Find(flat, [&](std::uint32_t r) {
+        return cards::MaskPointCount(db.Hand(r, position::north)) >= 10;
+    });
+    Test(strong.size() <= db.Count(flat), "residual filter");
+
+    auto b = db.Board(12345);
+    Test(b.number == all[12345].number && b.d.hands == all[12345].d.hands &&
+             b.d.contrct.GetDealer() == all[12345].d.contrct.GetDealer(),
+         "board round trip");
+
+    std::stringstream ss;
+    db.Save(ss);
+    database::dealbase loaded;
+    Test(loaded.Load(ss) && loaded.size() == db.size() && loaded.Find(majors) == found &&
+             loaded.Index(database::PointsOf(position::east), 10) ==
+                 db.Index(database::PointsOf(position::east), 10),
+         "save and load");
+    std::stringstream bad("DEALBAS2");
+    Test(!loaded.Load(bad), "bad file");
+    std::stringstream huge(std::string(4, '\xff'));
+    Test(!database::bitmap().Load(huge), "too many chunks");
+
+    database::dealbase parts;
+    parts.Add({all.begin(), all.begin() + 30000});
+    parts.Add({all.begin() + 30000, all.begin() + 30001});
+    parts.Add({all.begin() + 30001, all.end()});
+    Test(parts.size() == db.size() && parts.Find(majors) == found &&
+             parts.Index(database::PatternOf(position::west), 3) == db.Index(database::PatternOf(position::west), 3),
+         "added in parts");
+
+    return testsFailed;
+}
+
+int TestStress() {
+
+    int testsFailed = 0;
+    int testNumber = 0;
+
+    auto Test = [&testsFailed, &testNumber](const bool result, const std::string &description) {
+        if (!result) {
+            std::cout << "Test Stress failed " << testNumber << " " << description << "\n";
+            ++testsFailed;
+        }
+        ++testNumber;
+        return result;
+    };
+
+    auto report = bench::RunGames(4, 400, 3);
+    Test(report.games == 400 && report.violations == 0, "games played cleanly");
+    Test(report.passedOut < report.games && report.tricks == 13 * (report.games - report.passedOut),
+         "every contract played out");
+    Test(report.calls >= 4 * report.games, "auctions end with passes");
+    auto single = bench::RunGames(4, 400, 1);
+    Test(single.calls == report.calls && single.linkBytes == report.linkBytes &&
+             single.passedOut == report.passedOut,
+         "threads don't change the games");
+    Test(report.times.Seconds(bench::PlayPhase) > 0 && report.GamesPerSecond() > 0, "timed");
+    Test(report.to_string().find("auction") != std::string::npos, "report");
+
+    return testsFailed;
+}
+
+int TestCounters() {
+
+    int testsFailed = 0;
+    int testNumber = 0;
+
+    auto Test = [&testsFailed, &testNumber](const bool result, const std::string &description) {
+        if (!result) {
+            std::cout << "Test Counters failed " << testNumber << " " << description << "\n";
+            ++testsFailed;
+        }
+        ++testNumber;
+        return result;
+    };
+
+    bench::perfcounters pc;
+    auto m = bench::Measure(
+        "loop", 100000,
+        [](std::uint64_t n) {
+            std::uint64_t x = 0;
+            for (std::uint64_t i = 0; i < n; ++i)
+                bench::Keep(x += i);
+        },
+        &pc);
+    Test(m.ops == 100000 && m.nsPerOp > 0, "timed");
+    // Whether counters exist depends on the machine, and an open counter may still never be scheduled
+    Test(!m.perOp[bench::Instructions] || pc.Available(bench::Instructions), "counter present only when available");
+    Test(!m.perOp[bench::Instructions] || *m.perOp[bench::Instructions] >= 1, "at least an instruction an op");
+    Test(static_cast<bool>(m.Ipc()) == (m.perOp[bench::Cycles] && m.perOp[bench::Instructions]), "IPC");
+
+    auto none = bench::Measure("loop", 10, [](std::uint64_t) {});
+    Test(std::ranges::none_of(none.perOp, [](const auto &v) { return v.has_value(); }), "no counters asked for");
+
+    auto primitives = bench::MeasurePrimitives(2048, false);
+    Test(primitives.size() == 6 && primitives[1].name == "Hand::SetSuits", "every primitive measured");
+    auto table = bench::FormatMeasurements(primitives);
+    Test(table.find("contract::NextBidValid") != std::string::npos && table.find("IPC") != std::string::npos,
+         "table");
+
+    return testsFailed;
+}
+
+int TestCompactDeal() {
+
+    int testsFailed = 0;
+    int testNumber = 0;
+
+    auto Test = [&testsFailed, &testNumber](const bool result, const std::string &description) {
+        if (!result) {
+            std::cout << "Test CompactDeal failed " << testNumber << " " << description << "\n";
+            ++testsFailed;
+        }
+        ++testNumber;
+        return result;
+    };
+
+    static_assert(std::is_trivially_copyable_v<cards::compactdeal>);
+    Test(sizeof(cards::compactdeal) < 128, "compact");
+
+    cards::deal d(8, 0, 2);
+    d.contrct.SetDealer(cards::position::east);
+    d.SetVulnerability(cards::vulnerability::eastwest);
+    auto unbid = cards::compactdeal::FromDeal(d);
+    Test(unbid && unbid->NumCalls() == 0 && unbid->ToDeal().to_lin() == d.to_lin(), "no auction");
+    Test(unbid && unbid->HandMask(cards::position::north) == d.hands[2].Mask(), "hands");
+
+    for (auto call : {"1H", "D", "R", "2C", "P", "P", "3H", "P", "P", "P"})
+        d.contrct.AddBid(cards::bid(call));
+    PlayOut(d, [](const solver::playstate &ps) { return 63 - std::countl_zero(ps.LegalCards()); });
+    auto c = cards::compactdeal::FromDeal(d);
+    if (Test(static_cast<bool>(c), "played deal fits")) {
+        Test(c->NumCalls() == 10 && c->Call(2).IsReDouble() && c->NumTricks() == 13, "auction and play");
+        Test(c->GetDealer() == cards::position::east && c->GetVulnerability() == cards::vulnerability::eastwest,
+             "dealer and vulnerability");
+        cards::deal back = c->ToDeal();
+        Test(back.to_lin() == d.to_lin() && back == d, "round trip");
+        Test(back.contrct.declarer == d.contrct.declarer && back.tricks.back().WonBy() == d.tricks.back().WonBy(),
+             "declarer and tricks");
+
+        std::array<unsigned char, sizeof(cards::compactdeal)> buffer;
+        std::memcpy(buffer.data(), &*c, sizeof(cards::compactdeal));
+        cards::compactdeal copied;
+        std::memcpy(&copied, buffer.data(), sizeof(copied));
+        Test(copied == *c, "memcpy");
+    }
+
+    cards::deal longAuction(8, 0, 3);
+    longAuction.contrct.SetDealer(cards::position::south);
+    for (int level = 1; level <= 7 && longAuction.contrct.bids.size() <= cards::compactdeal::MaxCalls; ++level)
+        for (auto s : {"C", "D", "H", "S"})
+            for (auto call : {std::to_string(level) + s, std::string("P"), std::string("P"), std::string("D"),
+                              std::string("P"), std::string("P"), std::string("R"), std::string("P"),
+                              std::string("P")})
+                longAuction.contrct.AddBid(cards::bid(call));
+    Test(!cards::compactdeal::FromDeal(longAuction), "auction too long");
+
+    return testsFailed;
+}
+
+int TestParsers() {
+
+    int testsFailed = 0;
+    int testNumber = 0;
+
+    auto Test = [&testsFailed, &testNumber](const bool result, const std::string &description) {
+        if (!result) {
+            std::cout << "Test Parsers failed " << testNumber << " " << description << "\n";
+            ++testsFailed;
+        }
+        ++testNumber;
+        return result;
+    };
+
+    using cards::parseerror;
+    cards::Card c;
+    Test(cards::ParseCard("AS", c) && c == cards::MakeCard("AS"), "rank then suit");
+    Test(cards::ParseCard("sa", c) && c == cards::MakeCard("AS"), "LIN order");
+    Test(cards::ParseCard("10H", c) && c == cards::MakeCard("TH"), "ten");
+    Test(cards::ParseCard("AX", c).error == parseerror::badSuit, "bad suit");
+    auto bad = cards::ParseCard("S1", c);
+    Test(bad.error == parseerror::badRank && bad.offset == 1, "bad rank");
+    Test(cards::ParseCard("", c).error == parseerror::empty, "empty card");
+
+    cards::bid b;
+    Test(cards::ParseCall("Pass", b) && b.IsPass(), "pass");
+    Test(cards::ParseCall("XX", b) && b.IsReDouble() && cards::ParseCall("x", b) && b.IsDouble(), "doubles");
+    Test(cards::ParseCall("3NT", b) && b == cards::bid("3N"), "notrumps");
+    Test(cards::ParseCall("7c", b) && b == cards::bid("7C"), "suit");
+    Test(cards::ParseCall("8S", b).error == parseerror::badCall, "level too high");
+    Test(cards::ParseCall("2Z", b).error == parseerror::badCall, "bad strain");
+
+    std::uint64_t m;
+    std::uint64_t expected = 0;
+    for (auto card : {"AS", "KS", "QS", "2S", "JH", "TH", "9H", "8D", "7D", "6D", "5D", "AC", "KC"})
+        expected |= std::uint64_t{1} << cards::MakeCard(card).crd;
+    Test(cards::ParseHandMask("SAKQ2HJT9D8765CAK", m) && m == expected, "LIN hand");
+    std::uint64_t pbn;
+    Test(cards::ParseHandMask("AKQ2.JT9.8765.AK", pbn) && pbn == m, "PBN hand");
+    cards::Hand h;
+    Test(cards::ParseHand("AKQ2.J109.8765.AK", h) && h.PointCount() == 17 && h.SuitLength(3) == 4, "hand");
+    Test(cards::ParseHandMask("SAKQ2HJT9D8765CA", m).error == parseerror::tooFew, "too few");
+    Test(cards::ParseHandMask("SAKQ2HJT9D8765CAKQ", m).error == parseerror::tooMany, "too many");
+    auto twice = cards::ParseHandMask("SAKQ2HJT9D8765CAA", m);
+    Test(twice.error == parseerror::duplicate && twice.offset == 16, "duplicate");
+    Test(cards::ParseHandMask("AKQ2.JT9.8765.AK.2", m).error == parseerror::badSuit, "five suits");
+    Test(cards::ParseHandMask("AKQ2.JT9.8765.AKZ", m).error == parseerror::badRank, "bad rank in hand");
+
+    std::array<cards::bid, 8> calls;
+    std::size_t n;
+    Test(cards::ParseCalls("1S P 2H P 4S P P P", calls, n) && n == 8 && calls[4] == cards::bid("4S"), "calls");
+    auto full = cards::ParseCalls("1S P 2H P 4S P P P P", calls, n);
+    Test(full.error == parseerror::tooMany && full.offset == 19 && n == 8, "no room");
+    Test(cards::ParseCalls("1S P\r\n2H P\n", calls, n) && n == 4 && calls[2] == cards::bid("2H"), "calls over lines");
+
+    cards::contract auction;
+    auction.SetDealer(cards::position::north);
+    Test(cards::ParseAuction("1S-P-2H-P-4S-P-P-P", auction) &&
+             auction.finalContract.CallIndex() == cards::bid("4S").CallIndex() &&
+             auction.declarer == cards::position::north,
+         "auction");
+    cards::contract illegal;
+    illegal.SetDealer(cards::position::south);
+    auto low = cards::ParseAuction("1S 1H", illegal);
+    Test(low.error == parseerror::illegalCall && low.offset == 3, "insufficient bid");
+    cards::contract mistyped;
+    mistyped.SetDealer(cards::position::south);
+    auto typo = cards::ParseAuction("1S 2Q", mistyped);
+    Test(typo.error == parseerror::badCall && typo.offset == 4, "typo offset");
+
+    std::array<cards::Card, 52> play;
+    Test(cards::ParsePlay("SA S2 S5 SK|HA,H3", play, n) && n == 6 && play[3] == cards::MakeCard("KS"), "play");
+    Test(cards::ParsePlay("SA S2 SA", play, n).error == parseerror::duplicate, "card played twice");
+
+    return testsFailed;
+}
+
+int TestScoring() {
+
+    int testsFailed = 0;
+    int testNumber = 0;
+
+    auto Test = [&testsFailed, &testNumber](const bool result, const std::string &description) {
+        if (!result) {
+            std::cout << "Test Scoring failed " << testNumber << " " << description << "\n";
+            ++testsFailed;
+        }
+        ++testNumber;
+        return result;
+    };
+
+    using cards::suit;
+    using scoring::ContractScore;
+    Test(ContractScore(4, suit::spades, 0, false, 10) == 420 &&
+             ContractScore(4, suit::spades, 0, true, 10) == 620,
+         "major game");
+    Test(ContractScore(3, suit::notrumps, 0, false, 10) == 430, "3NT+1");
+    Test(ContractScore(1, suit::notrumps, 1, false, 7) == 180 &&
+             ContractScore(1, suit::notrumps, 2, true, 7) == 760,
+         "doubled into game");
+    Test(ContractScore(2, suit::diamonds, 1, true, 9) == 380, "doubled overtrick");
+    Test(ContractScore(7, suit::notrumps, 0, true, 13) == 2220 &&
+             ContractScore(6, suit::clubs, 0, false, 12) == 920,
+         "slams");
+    Test(ContractScore(3, suit::spades, 0, true, 8) == -100, "one down");
+    Test(ContractScore(4, suit::hearts, 1, false, 7) == -500 &&
+             ContractScore(4, suit::hearts, 1, true, 7) == -800,
+         "doubled undertricks");
+    Test(ContractScore(6, suit::clubs, 2, false, 8) == -1600, "redoubled undertricks");
+
+    Test(scoring::Imps(10) == 0 && scoring::Imps(20) == 1 && scoring::Imps(-40) == -1 &&
+             scoring::Imps(470) == 10 && scoring::Imps(5000) == 24,
+         "IMP scale");
+
+    scoring::traveller t;
+    t.vul = cards::vulnerability::eastwest;
+    t.Add(cards::bid("4S"), scoring::Undoubled, cards::position::north, 10);
+    t.Add(cards::bid("4S"), scoring::Undoubled, cards::position::south, 10);
+    t.Add(cards::bid("4S"), scoring::Undoubled, cards::position::north, 11);
+    t.Add(cards::bid("5D"), scoring::Doubled, cards::position::east, 10);
+    t.PassedOut();
+    Test(t.nsScore == std::vector<int>{420, 420, 450, 200, 0}, "traveller scores");
+
+    auto near = [](double a, double b) { return a > b - 1e-9 && a < b + 1e-9; };
+    auto mp = scoring::Matchpoints(t.nsScore);
+    Test(near(mp[2], 1) && near(mp[0], 2.5 / 4) && near(mp[4], 0), "matchpoints");
+    auto scaled = scoring::Matchpoints({450, 420, 420, -50}, 5);
+    Test(near(scaled[0], 3.875 / 4), "Neuberg");
+
+    // Against comparing every pair
+    cards::counter_rng rng(12, 0);
+    std::vector<int> scores(300);
+    for (auto &sc : scores)
+        sc = 10 * (static_cast<int>(rng.Below(300)) - 150);
+    auto cross = scoring::CrossImps(scores);
+    bool same = true;
+    for (std::size_t i = 0; i < scores.size(); ++i) {
+        long total = 0;
+        for (std::size_t j = 0; j < scores.size(); ++j)
+            total += j == i ? 0 : scoring::Imps(scores[i] - scores[j]);
+        same = same && near(cross[i], static_cast<double>(total) / (scores.size() - 1));
+    }
+    Test(same, "cross-IMPs");
+    auto mps = scoring::Matchpoints(scores);
+    bool sameMps = true;
+    for (std::size_t i = 0; i < scores.size(); ++i) {
+        double points = 0;
+        for (std::size_t j = 0; j < scores.size(); ++j)
+            points += j == i ? 0 : (scores[i] > scores[j] ? 1 : (scores[i] == scores[j] ? 0.5 : 0));
+        sameMps = sameMps && near(mps[i], points / (scores.size() - 1));
+    }
+    Test(sameMps, "matchpoints by pairs");
+
+    Test(scoring::Datum({420, 420, 450, 200, 0}) == 350 && scoring::Datum({100}) == 100, "datum");
+    Test(scoring::Butler({420, -100}, 350) == std::vector<int>{2, -10}, "Butler");
+
+    std::vector<scoring::traveller> event(30, t);
+    event[3].nsScore.pop_back();
+    auto boards = scoring::ScoreEvent(event, 0.1, 4);
+    Test(boards.size() == 30 && boards[0].datum == 350 && boards[0].butler[2] == 3, "event");
+    Test(near(boards[3].matchpoints[2], 3.875 / 4), "Neuberg across the event");
+
+    return testsFailed;
+}
+
+int TestBounds() {
+
+    int testsFailed = 0;
+    int testNumber = 0;
+
+    auto Test = [&testsFailed, &testNumber](const bool result, const std::string &description) {
+        if (!result) {
+            std::cout << "Test Bounds failed " << testNumber << " " << description << "\n";
+            ++testsFailed;
+        }
+        ++testNumber;
+        return result;
+    };
+
+    using cards::position;
+    solver::solver dds;
+
+    {
+        cards::counter_rng rng(44, 0);
+        bool bracket = true;
+        bool ordered = true;
+        int exact = 0;
+        for (int k = 0; k < 300; ++k) {
+            rng.Seek(k);
+            auto ps = RandomEnding(rng, 3 + k % 5, k % (solver::NoTrumps + 1));
+            for (auto side : {position::north, position::east}) {
+                auto b = solver::BoundTricks(ps, side);
+                int t = dds.Tricks(ps, side);
+                bracket = bracket && b.lower <= t && t <= b.upper;
+                ordered = ordered && 0 <= b.lower && b.lower <= b.upper && b.upper <= ps.TricksLeft();
+                exact += b.lower == b.upper;
+            }
+        }
+        Test(bracket, "bounds bracket the double dummy result");
+        Test(ordered, "bounds are in order");
+        Test(exact > 0, "some endings are settled by the bounds");
+    }
+
+    {
+        bool bracket = true;
+        for (int i = 0; i < 12; ++i) {
+            cards::deal d(31, 0, i);
+            int trumps = i % (solver::NoTrumps + 1);
+            auto b = solver::BoundTricks(d, trumps, position::west, position::south);
+            int t = dds.Tricks(solver::MakePlayState(d, trumps, position::west), position::south);
+            bracket = bracket && b.lower <= t && t <= b.upper;
+        }
+        Test(bracket, "full deals are bracketed");
+    }
+
+    {
+        solver::playstate ps;
+        const std::array<std::string, cards::numPlayers> seats = {
+            "AS KS QS JS TS 9S 8S 7S 6S 5S 4S 3S 2S", "AH KH QH JH TH 9H 8H 7H 6H 5H 4H 3H 2H",
+            "AD KD QD JD TD 9D 8D 7D 6D 5D 4D 3D 2D", "AC KC QC JC TC 9C 8C 7C 6C 5C 4C 3C 2C"};
+        for (int p = 0; p < cards::numPlayers; ++p)
+            ps.hands[p] = MakeHand(seats[p]).Mask();
+        ps.leader = position::west;
+        ps.trumps = solver::NoTrumps;
+        auto b = solver::BoundTricks(ps, position::west);
+        Test(b.lower == 13 && b.upper == 13, "solid suit on lead");
+        b = solver::BoundTricks(ps, position::north);
+        Test(b.lower == 0 && b.upper == 0, "and nothing for the other side");
+        ps.trumps = static_cast<int>(cards::suit::spades);
+        b = solver::BoundTricks(ps, position::south);
+        Test(b.lower == 13, "solid trumps");
+    }
+
+    return testsFailed;
+}
+
+int TestAgents() {
+
+    int testsFailed = 0;
+    int testNumber = 0;
+
+    auto Test = [&testsFailed, &testNumber](const bool result, const std::string &description) {
+        if (!result) {
+            std::cout << "Test Agents failed " << testNumber << " " << description << "\n";
+            ++testsFailed;
+        }
+        ++testNumber;
+        return result;
+    };
+
+    using cards::position;
+    cards::deal d(position::south);
+    d.hands[0] = MakeHand("AS KS QS JS TS 9S 8S 7S 6S 5S 4S 3S 2S");
+    d.hands[1] = MakeHand("JH TH 9H 8H 6D 5D 4D 3D 2D 5C 4C 3C 2C");
+    d.hands[2] = MakeHand("KH QH 4H 3H 2H AD KD QD JD TD 9D 8D 7D");
+    d.hands[3] = MakeHand("AH 7H 6H 5H AC KC QC JC TC 9C 8C 7C 6C");
+    for (auto call : {"1NT", "P", "P", "P"})
+        d.contrct.AddBid(cards::bid(call));
+
+    // The card agent a picks for the next seat to play once `before` is played from leader
+    auto choose = [&d](agents::agent a, position leader, std::initializer_list<const char *> before) {
+        solver::handmasks held;
+        for (int p = 0; p < cards::numPlayers; ++p)
+            held[p] = d.hands[p].Mask();
+        cards::trick t;
+        t.SetLeadPos(leader);
+        t.InitFromContract(d.contrct);
+        position seat = leader;
+        for (auto c : before) {
+            t.PlayCard(cards::MakeCard(c));
+            held[static_cast<int>(seat)] &= ~solver::Bit(cards::MakeCard(c).crd);
+            seat = cards::Lefty(seat);
+        }
+        agents::seatview v{d.hands[static_cast<int>(seat)], t, held, seat, d.contrct.declarer, solver::NoTrumps,
+                           true};
+        return a(v).to_link();
+    };
+
+    Test(choose(agents::Defender, position::north, {"KH"}) == "HA", "cover an honour");
+    Test(choose(agents::Defender, position::north, {"2H"}) == "H5", "second hand low");
+    Test(choose(agents::Defender, position::east, {"5H", "2S"}) == "H8", "third hand high, lowest of equals");
+    Test(choose(agents::Declarer, position::east, {"5H", "2S", "8H"}) == "HQ", "fourth hand wins cheaply");
+    Test(choose(agents::Defender, position::north, {"QD"}) == "H5", "discard a loser, not a winner");
+    Test(choose(agents::Defender, position::west, {}) == "HJ", "lead the top of a sequence");
+
+    {
+        cards::deal played = d;
+        int taken = agents::PlayOut(played, agents::Declarer, agents::Defender);
+        Test(played.GetTricksPlayed() == cards::CardsInHand, "deal played out");
+        solver::solver dds;
+        auto ps = solver::MakePlayState(d, solver::NoTrumps, position::west);
+        Test(taken == dds.Tricks(ps, position::south), "no tricks thrown away");
+    }
+
+    {
+        auto nt = cards::bid("3NT");
+        auto play = [&nt](agents::agent declarer, std::uint64_t count, std::size_t solveEvery, unsigned threads) {
+            return agents::SimulatePlay(5, count, nt, position::south, declarer, agents::Defender, solveEvery,
+                                        threads);
+        };
+        auto one = play(agents::Declarer, 300, 0, 1);
+        auto four = play(agents::Declarer, 300, 0, 4);
+        Test(one.deals == 300 && one.tricks == four.tricks, "thread count doesn't matter");
+        Test(one.Practical() > play(agents::Lowest, 300, 0, 4).Practical(), "planning beats playing low");
+
+        auto solved = play(agents::Declarer, 30, 10, 2);
+        Test(solved.solved == 3, "every tenth deal solved");
+        Test(std::abs(solved.Shortfall()) < 3, "practical play close to double dummy");
+    }
+
+    return testsFailed;
+}
+
+int TestSink() {
+
+    int testsFailed = 0;
+    int testNumber = 0;
+
+    auto Test = [&testsFailed, &testNumber](const bool result, const std::string &description) {
+        if (!result) {
+            std::cout << "Test Sink failed " << testNumber << " " << description << "\n";
+            ++testsFailed;
+        }
+        ++testNumber;
+        return result;
+    };
+
+    auto readBack = [](std::FILE *f) {
+        std::string text;
+        std::rewind(f);
+        char buf[4096];
+        for (std::size_t n; (n = std::fread(buf, 1, sizeof buf, f)) > 0;)
+            text.append(buf, n);
+        return text;
+    };
+
+    for (bool useRing : {true, false}) {
+        std::string how = useRing && sink::writer(-1).UsingRing() ? " (io_uring)" : " (writev)";
+        {
+            // Four producers hand over interleaved sequence numbers with little room to queue
+            std::FILE *f = std::tmpfile();
+            sink::writer w(fileno(f), 64, 2, useRing);
+            {
+                std::vector<std::jthread> producers;
+                for (int t = 0; t < 4; ++t) {
+                    producers.emplace_back([&w, t] {
+                        for (int i = t; i < 400; i += 4) {
+                            std::string b = w.Buffer();
+                            b += "record " + std::to_string(i) + "\n";
+                            w.Submit(i, std::move(b));
+                        }
+                    });
+                }
+            }
+            Test(w.Close(), "ordered writes succeed" + how);
+            std::string expected;
+            for (int i = 0; i < 400; ++i)
+                expected += "record " + std::to_string(i) + "\n";
+            Test(readBack(f) == expected, "written in sequence order" + how);
+            Test(w.BytesWritten() == expected.size() && w.Writes() <= 400, "batched" + how);
+            std::fclose(f);
+        }
+        {
+            std::FILE *f = std::tmpfile();
+            sink::writer w(fileno(f), 100, 4, useRing);
+            {
+                std::vector<std::jthread> producers;
+                for (int t = 0; t < 3; ++t) {
+                    producers.emplace_back([&w, t] {
+                        sink::stream out(w);
+                        for (int i = 0; i < 1000; ++i)
+                            out.Append(std::to_string(t) + " " + std::to_string(i) + "\n");
+                    });
+                }
+            }
+            Test(w.Close(), "streams flush at the end" + how);
+            std::istringstream lines(readBack(f));
+            std::array<int, 3> next{};
+            bool inOrder = true;
+            int count = 0;
+            for (int t, i; lines >> t >> i; ++count) {
+                inOrder = inOrder && t >= 0 && t < 3 && i == next[t];
+                ++next[t];
+            }
+            Test(count == 3000 && inOrder, "every record, each thread's in order" + how);
+            std::fclose(f);
+        }
+        {
+            sink::writer w(-1, 16, 1, useRing);
+            w.Submit(std::string("lost"));
+            Test(!w.Close(), "write errors reported" + how);
+        }
+    }
+
+    return testsFailed;
+}
+
+int TestGenerator() {
+
+    int testsFailed = 0;
+    int testNumber = 0;
+
+    auto Test = [&testsFailed, &testNumber](const bool result, const std::string &description) {
+        if (!result) {
+            std::cout << "Test Generator failed " << testNumber << " " << description << "\n";
+            ++testsFailed;
+        }
+        ++testNumber;
+        return result;
+    };
+
+    using cards::position;
+    auto strong = bidding::bidder::ParseConstraint("hcp 15-17 spades 2-4 with AS");
+    Test(strong && strong->Matches(bidding::handfeatures(MakeHand("AS KS 2S AH KH 3H 2H QD 3D 2D 4C 3C 2C"))) &&
+             !strong->Matches(bidding::handfeatures(MakeHand("QS KS 2S AH KH 3H 2H AD 3D 2D 4C 3C 2C"))),
+         "constraint");
+    Test(!bidding::bidder::ParseConstraint("hcp 17-15") && !bidding::bidder::ParseConstraint("with ZZ") &&
+             !bidding::bidder::ParseConstraint("tall"),
+         "bad constraints");
+
+    cards::deal first = generator::MakeDeal(3, 0);
+    std::string pbn;
+    generator::Append(pbn, first, 0, generator::format::pbn);
+    Test(pbn == "[Board \"1\"]\n[Dealer \"N\"]\n[Vulnerable \"None\"]\n[Deal \"" + first.to_pbn() + "\"]\n\n",
+         "pbn tags");
+    std::string binary;
+    generator::Append(binary, generator::MakeDeal(3, 5), 5, generator::format::binary);
+    cards::compactdeal back;
+    Test(binary.size() == sizeof back, "binary record size");
+    std::memcpy(&back, binary.data(), sizeof back);
+    Test(back.ToDeal().hands == generator::MakeDeal(3, 5).hands && back.GetDealer() == boards::BoardDealer(6) &&
+             back.GetVulnerability() == boards::BoardVulnerability(6),
+         "binary record");
+
+    generator::seatconstraints seats{};
+    seats[static_cast<int>(position::north)] = bidding::bidder::ParseConstraint("hcp 12-40");
+    std::vector<generator::block> blocks(5);
+    auto next = generator::MakeRound(blocks, 3, 100, 1000, seats, generator::format::lin, 3, 64);
+    Test(next == 420, "round size");
+    std::string text;
+    std::size_t records = 0;
+    for (const auto &bl : blocks) {
+        text += bl.text;
+        records += bl.ends.size();
+    }
+    std::string expected;
+    std::size_t qualified = 0;
+    for (std::uint64_t i = 100; i < 420; ++i) {
+        cards::deal d = generator::MakeDeal(3, i);
+        if (d.hands[static_cast<int>(position::north)].PointCount() < 12)
+            continue;
+        generator::Append(expected, d, i, generator::format::lin);
+        ++qualified;
+    }
+    Test(qualified > 0 && records == qualified && text == expected, "constraints filter in index order");
+    std::vector<generator::block> single(5);
+    generator::MakeRound(single, 3, 100, 1000, seats, generator::format::lin, 1, 64);
+    Test(std::ranges::equal(single, blocks, [](const auto &a, const auto &b) { return a.text == b.text; }),
+         "thread count doesn't matter");
+    for (auto fmt : {generator::format::pbn, generator::format::binary}) {
+        generator::MakeRound(single, 3, 100, 1000, seats, fmt, 1, 64);
+        std::string made, appended;
+        for (const auto &b : single)
+            made += b.text;
+        for (std::uint64_t i = 100; i < 420; ++i) {
+            cards::deal d = generator::MakeDeal(3, i);
+            if (d.hands[static_cast<int>(position::north)].PointCount() >= 12)
+                generator::Append(appended, d, i, fmt);
+        }
+        Test(made == appended, "records written from the deck match those of the deal");
+    }
+
+    Test(generator::MakeRound(blocks, 3, 0, 150, {}, generator::format::text, 2, 64) == 150 &&
+             blocks[2].ends.size() == 22 && blocks[3].ends.empty() && blocks[4].text.empty(),
+         "limit cuts the round");
+    generator::block bl = blocks[1];
+    Test(generator::MakeRound(blocks, 3, 150, 150, {}, generator::format::text, 2, 64) == 150 &&
+             blocks[0].ends.empty(),
+         "nothing left to try");
+
+    std::size_t firstEnd = bl.ends[0];
+    Test(bl.Trim(1) == 1 && bl.text.size() == firstEnd && bl.ends.size() == 1, "trim");
+    Test(bl.Trim(5) == 1 && bl.Trim(0) == 0 && bl.text.empty(), "trim past the end and to nothing");
+
+    return testsFailed;
+}
+
+int TestReplay() {
+
+    int testsFailed = 0;
+    int testNumber = 0;
+
+    auto Test = [&testsFailed, &testNumber](const bool result, const std::string &description) {
+        if (!result) {
+            std::cout << "Test Replay failed " << testNumber << " " << description << "\n";
+            ++testsFailed;
+        }
+        ++testNumber;
+        return result;
+    };
+
+    // Boards recorded the way a program would write them: a contract, played out
+    std::vector<bench::recordedboard> corpus;
+    for (int i = 0; i < 8; ++i) {
+        cards::deal d(9, 0, i);
+        d.contrct.SetDealer(static_cast<cards::position>(i % 4));
+        d.SetVulnerability(i % 2 ? cards::vulnerability::both : cards::vulnerability::neither);
+        cards::ParseAuction(i < 6 ? "1S P 2C X 4S P P P" : "P P P P", d.contrct);
+        if (d.contrct.finalContract.IsABid())
+            agents::PlayOut(d, agents::Declarer, agents::Defender);
+        auto b = bench::ParseRecordedBoard(d.to_lin() + "\n");
+        Test(b && b->calls.size() == d.contrct.bids.size() &&
+                 b->plays.size() == static_cast<std::size_t>(4 * d.GetTricksPlayed()) &&
+                 b->start.hands == cards::deal(9, 0, i).hands &&
+                 b->start.GetVulnerability() == d.GetVulnerability(),
+             "board read back " + std::to_string(i));
+        if (b)
+            corpus.push_back(std::move(*b));
+    }
+
+    auto once = bench::ReplayCorpus(corpus, 1);
+    Test(once.boards == 8 && once.mismatches == 0 && once.cards == 6 * 52 &&
+             once.calls == 6 * 8 + 2 * 4,
+         "replays as recorded");
+    Test(!once.AllocationsPerBoard(), "allocations not counted without the replay tool");
+    auto threaded = bench::ReplayCorpus(corpus, 5, 3);
+    Test(threaded.boards == 40 && threaded.mismatches == 0 && threaded.linkBytes == 5 * once.linkBytes,
+         "threads replay the same");
+
+    // Three hands given, an alert, and a record not written by deal::to_lin
+    {
+        const char *lin = "md|3SAKQJHAKQJDAKQJCA,S2345H2345D2345C2,S6789H6789D6789C3,|sv|o|"
+                          "mb|7N!|mb|p|mb|p|mb|p|pc|ST|pc|SA|pc|S2|pc|S6|";
+        auto b = bench::ParseRecordedBoard(lin);
+        std::uint64_t all = 0;
+        if (b) {
+            for (const auto &h : b->start.hands)
+                all |= h.Mask();
+        }
+        Test(b && std::popcount(all) == 52 && b->start.contrct.GetDealer() == cards::position::north &&
+                 b->calls.size() == 4 && b->plays.size() == 4,
+             "fourth hand filled in");
+        bench::replayreport r;
+        if (b) {
+            bench::ReplayBoard(*b, r);
+            Test(r.mismatches == 1 && r.cards == 4, "a different link is a mismatch");
+        }
+    }
+    Test(!bench::ParseRecordedBoard("md|5SAKQJ|"), "bad dealer");
+    Test(!bench::ParseRecordedBoard("sv|o|mb|1S|"), "no deal");
+    Test(!bench::ParseRecordedBoard("md|1SAKQJHAKQJDAKQJCA,SAKQJHAKQJDAKQJCA,,|"), "cards dealt twice");
+    Test(!bench::ParseRecordedBoard(corpus[0].lin + "pc|S2|"), "part of a trick");
+    {
+        auto bad = corpus[0];
+        std::swap(bad.plays[0], bad.plays[1]);
+        bench::replayreport r;
+        bench::ReplayBoard(bad, r);
+        Test(r.mismatches == 1, "card from the wrong hand refused");
+    }
+
+    bench::replaybaseline base{1000, 20.5, 2};
+    auto read = bench::replaybaseline::FromJson(base.to_json());
+    Test(read && read->boardsPerSecond == 1000 && read->allocationsPerBoard == 20.5 && read->threads == 2,
+         "baseline round trip");
+    Test(bench::replaybaseline::FromJson(R"({"threads":1, "boardsPerSecond" : 5e4})")->boardsPerSecond == 5e4,
+         "JSON spacing");
+    Test(!bench::replaybaseline::FromJson("{\"threads\": 1}") && !bench::replaybaseline::FromJson(""),
+         "baseline needs a speed");
+
+    bench::replayreport r;
+    r.boards = 1000;
+    r.wallSeconds = 1;
+    r.allocations = 21000;
+    r.allocationsCounted = true;
+    Test(bench::CompareToBaseline(r, 2, base, 0.1).empty(), "within tolerance");
+    Test(bench::CompareToBaseline(r, 2, base, 0.01).size() == 1, "too many allocations");
+    r.wallSeconds = 1.2;
+    Test(bench::CompareToBaseline(r, 2, base, 0.1).size() == 1, "too slow");
+    Test(bench::CompareToBaseline(r, 1, base, 0.3).size() == 1, "threads differ");
+    r.mismatches = 1;
+    Test(bench::CompareToBaseline(r, 2, base, 0.3).size() == 1, "mismatches always fail");
+    r.allocationsCounted = false;
+    r.mismatches = 0;
+    Test(bench::CompareToBaseline(r, 2, base, 0.3).empty(), "uncounted allocations aren't compared");
+
+    return testsFailed;
+}
+
 int RunAllTests() {
     int testsFailed = 0;
     testsFailed += TestStructCard();
@@ -585,6 +2545,28 @@ int RunAllTests() {
     testsFailed += TestBid();
     testsFailed += TestContract();
     testsFailed += TestTricks();
+    testsFailed += TestRandomStreams();
+    testsFailed += TestDealSource();
+    testsFailed += TestBoards();
+    testsFailed += TestBidding();
+    testsFailed += TestAuctionTrie();
+    testsFailed += TestSolver();
+    testsFailed += TestReview();
+    testsFailed += TestCompletions();
+    testsFailed += TestSuitPlay();
+    testsFailed += TestStats();
+    testsFailed += TestSampling();
+    testsFailed += TestDatabase();
+    testsFailed += TestStress();
+    testsFailed += TestCounters();
+    testsFailed += TestCompactDeal();
+    testsFailed += TestParsers();
+    testsFailed += TestScoring();
+    testsFailed += TestBounds();
+    testsFailed += TestAgents();
+    testsFailed += TestSink();
+    testsFailed += TestGenerator();
+    testsFailed += TestReplay();
 
     if (testsFailed > 0) {
         std::cout << "Some tests failed" << std::endl;
@@ -0,0 +1,124 @@
+module;
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+export module workers;
+
+export namespace workers {
+
+inline unsigned DefaultThreads() {
+    unsigned n = std::thread::hardware_concurrency();
+    return n > 0 ? n : 1;
+}
+
+// Calls fn(index, worker) for every index in [0, n). Indices are handed out in
+// chunks from a shared counter so slow items don't leave threads idle; worker
+// is in [0, threads) and can be used to pick per-thread state.
+template <typename F>
+void ParallelFor(std::size_t n, unsigned threads, F &&fn, std::size_t chunk = 16) {
+    assert(chunk > 0);
+    threads = std::max(1u, std::min<unsigned>(threads, (n + chunk - 1) / chunk));
+    if (threads <= 1) {
+        for (std::size_t i = 0; i < n; ++i)
+            fn(i, 0u);
+        return;
+    }
+    std::atomic<std::size_t> next{0};
+    auto run = [&](unsigned worker) {
+        for (;;) {
+            std::size_t first = next.fetch_add(chunk, std::memory_order_relaxed);
+            if (first >= n)
+                return;
+            std::size_t last = std::min(n, first + chunk);
+            for (std::size_t i = first; i < last; ++i)
+                fn(i, worker);
+        }
+    };
+    std::vector<std::jthread> pool;
+    pool.reserve(threads - 1);
+    for (unsigned w = 1; w < threads; ++w)
+        pool.emplace_back(run, w);
+    run(0);
+}
+
+// Calls fn(index, worker) for every index in [0, n) by work stealing. Each
+// thread starts with its own contiguous share of the indices and works through
+// it in order; one that runs out takes the back half of the largest share
+// left. Neighbouring indices so mostly run one after another on one thread,
+// which suits work that carries state from one index to the next, and no
+// thread is idle while another has work queued. Shares are only split at
+// multiples of grain.
+template <typename F> void StealingFor(std::size_t n, unsigned threads, F &&fn, std::size_t grain = 1) {
+    assert(grain > 0);
+    std::size_t units = (n + grain - 1) / grain;
+    threads = std::max(1u, std::min<unsigned>(threads, units));
+    if (threads <= 1) {
+        for (std::size_t i = 0; i < n; ++i)
+            fn(i, 0u);
+        return;
+    }
+    struct share {
+        std::mutex lock;
+        std::size_t next = 0; // in units of grain
+        std::size_t end = 0;
+    };
+    std::vector<share> shares(threads);
+    for (unsigned w = 0; w < threads; ++w) {
+        shares[w].next = units * w / threads;
+        shares[w].end = units * (w + 1) / threads;
+    }
+    auto run = [&](unsigned worker) {
+        share &own = shares[worker];
+        for (;;) {
+            std::size_t unit;
+            {
+                std::lock_guard<std::mutex> hold(own.lock);
+                unit = own.next < own.end ? own.next++ : units;
+            }
+            if (unit < units) {
+                for (std::size_t i = unit * grain; i < std::min(n, (unit + 1) * grain); ++i)
+                    fn(i, worker);
+                continue;
+            }
+            // Work only ever moves between shares, so when every share is
+            // empty (or in the hands of a thief) this thread is done
+            std::size_t first = 0;
+            std::size_t last = 0;
+            for (unsigned tries = 0; tries < threads && first == last; ++tries) {
+                unsigned victim = worker;
+                std::size_t most = 0;
+                for (unsigned w = 0; w < threads; ++w) {
+                    std::lock_guard<std::mutex> hold(shares[w].lock);
+                    if (shares[w].end - shares[w].next > most) {
+                        most = shares[w].end - shares[w].next;
+                        victim = w;
+                    }
+                }
+                if (most == 0)
+                    return;
+                std::lock_guard<std::mutex> hold(shares[victim].lock);
+                share &v = shares[victim];
+                if (v.end > v.next) {
+                    first = v.next + (v.end - v.next) / 2;
+                    last = v.end;
+                    v.end = first;
+                }
+            }
+            std::lock_guard<std::mutex> hold(own.lock);
+            own.next = first;
+            own.end = last;
+        }
+    };
+    std::vector<std::jthread> pool;
+    pool.reserve(threads - 1);
+    for (unsigned w = 1; w < threads; ++w)
+        pool.emplace_back(run, w);
+    run(0);
+}
+} // namespace workers